@@ -0,0 +1,441 @@
+/** \file correction.c
+ * \brief Pixel correction stage for the NET iCube acquisition interface.
+ */
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "correction.h"
+#include "pixelkernels.h"
+
+/* Largest defect list read.                                              */
+#define DEFECTS_MAX 65536
+
+void CorrectionInit(TCorrection * corr)
+{
+    memset(corr, 0, sizeof(TCorrection));
+}
+
+static void FreeReference(TReference * ref)
+{
+    free(ref->pixel);
+    memset(ref, 0, sizeof(TReference));
+}
+
+void CorrectionFree(TCorrection * corr)
+{
+    free(corr->lut);
+    FreeReference(&corr->flat);
+    FreeReference(&corr->dark);
+    free(corr->defect);
+    free(corr->gain);
+    free(corr->offset);
+    free(corr->defect_index);
+    CorrectionInit(corr);
+}
+
+HBOOL CorrectionLoaded(const TCorrection * corr)
+{
+    return corr->lut || corr->flat.pixel || corr->dark.pixel || corr->num_defects > 0;
+}
+
+/* Read a number of a PGM header, skipping white space and comments.     */
+static INT ReadHeaderValue(FILE * f, INT * value)
+{
+    int c;
+
+    while((c = fgetc(f)) != EOF)
+    {
+        if(c == '#')
+            while((c = fgetc(f)) != EOF && c != '\n');
+        else if(!isspace(c))
+            break;
+    }
+    if(c == EOF || !isdigit(c))
+        return 1;
+    for(*value = 0; c != EOF && isdigit(c); c = fgetc(f))
+        *value = *value * 10 + (c - '0');
+
+    /* a single white space character ends the header */
+    return c == EOF || !isspace(c);
+}
+
+/* Load a binary PGM image, scaling its pixels to 16 bits.               */
+static INT LoadPGM(const char * filename, TReference * ref)
+{
+    FILE * f;
+    HBYTE * data = NULL;
+    INT width, height, maxval, bytes, i, err = 1;
+    UINT v;
+
+    if(!(f = fopen(filename, "rb")))
+        return 1;
+    if(fgetc(f) != 'P' || fgetc(f) != '5' || ReadHeaderValue(f, &width) || ReadHeaderValue(f, &height) || ReadHeaderValue(f, &maxval)
+       || width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535)
+    {
+        fclose(f);
+        return 1;
+    }
+
+    /* deeper images hold two bytes per pixel, most significant first */
+    bytes = maxval > 255 ? 2 : 1;
+    data = (HBYTE *)malloc((size_t)width * height * bytes);
+    ref->pixel = (UINT2 *)malloc((size_t)width * height * sizeof(UINT2));
+    if(data && ref->pixel && fread(data, bytes, (size_t)width * height, f) == (size_t)width * height)
+    {
+        for(i = 0; i < width * height; i++)
+        {
+            v = bytes == 2 ? (UINT)data[2 * i] << 8 | data[2 * i + 1] : data[i];
+            v = v < (UINT)maxval ? v : (UINT)maxval;
+            ref->pixel[i] = (UINT2)((v * 65535u + maxval / 2) / maxval);
+        }
+        ref->width = width;
+        ref->height = height;
+        err = 0;
+    }
+    free(data);
+    fclose(f);
+    if(err)
+        FreeReference(ref);
+
+    return err;
+}
+
+/* Replace a loaded reference with the image of a file, or drop it.      */
+static INT LoadReference(TCorrection * corr, const char * filename, TReference * ref, char * name)
+{
+    TReference loaded;
+
+    if(strlen(filename) >= CORRECTION_PATH_MAX)
+        return 1;
+    memset(&loaded, 0, sizeof(loaded));
+    if(filename[0] && LoadPGM(filename, &loaded) != 0)
+        return 1;
+    FreeReference(ref);
+    *ref = loaded;
+    strcpy(name, filename);
+    corr->prepared = FALSE;
+
+    return 0;
+}
+
+INT CorrectionLoadFlat(TCorrection * corr, const char * filename)
+{
+    return LoadReference(corr, filename, &corr->flat, corr->flat_file);
+}
+
+INT CorrectionLoadDark(TCorrection * corr, const char * filename)
+{
+    return LoadReference(corr, filename, &corr->dark, corr->dark_file);
+}
+
+INT CorrectionLoadLut(TCorrection * corr, const char * filename)
+{
+    UINT2 * lut = NULL;
+    FILE * f;
+    long v;
+    INT i, n = 0, depth = 0;
+
+    if(strlen(filename) >= CORRECTION_PATH_MAX)
+        return 1;
+    if(filename[0])
+    {
+        if(!(f = fopen(filename, "r")))
+            return 1;
+        lut = (UINT2 *)malloc((1 << STATISTICS_DEPTH_MAX) * sizeof(UINT2));
+        while(lut && n < 1 << STATISTICS_DEPTH_MAX && fscanf(f, "%ld", &v) == 1)
+            lut[n++] = (UINT2)(v < 0 ? 0 : v > 65535 ? 65535 : v);
+        /* anything but white space after the last entry is an error */
+        if(lut && fscanf(f, " %*c") != EOF)
+            n = 0;
+        fclose(f);
+        for(depth = 8; depth <= STATISTICS_DEPTH_MAX && 1 << depth != n; depth += 2);
+        if(depth > STATISTICS_DEPTH_MAX)
+        {
+            free(lut);
+            return 1;
+        }
+        for(i = 0; i < n; i++)
+            if(lut[i] >= n)
+                lut[i] = (UINT2)(n - 1);
+    }
+    free(corr->lut);
+    corr->lut = lut;
+    corr->lut_depth = depth;
+    strcpy(corr->lut_file, filename);
+    corr->prepared = FALSE;
+
+    return 0;
+}
+
+static int CompareDefects(const void * a, const void * b)
+{
+    const TDefect * da = (const TDefect *)a, * db = (const TDefect *)b;
+
+    if(da->row != db->row)
+        return da->row < db->row ? -1 : 1;
+
+    return da->col < db->col ? -1 : da->col > db->col;
+}
+
+INT CorrectionLoadDefects(TCorrection * corr, const char * filename)
+{
+    char line[256];
+    TDefect * defect = NULL;
+    FILE * f;
+    INT n = 0, err = 0;
+    char * p;
+
+    if(strlen(filename) >= CORRECTION_PATH_MAX)
+        return 1;
+    if(filename[0])
+    {
+        if(!(f = fopen(filename, "r")))
+            return 1;
+        defect = (TDefect *)malloc(DEFECTS_MAX * sizeof(TDefect));
+        while(!err && defect && fgets(line, sizeof(line), f))
+        {
+            if((p = strchr(line, '#')))
+                *p = '\0';
+            for(p = line; isspace((unsigned char)*p); p++);
+            if(!*p)
+                continue;
+            if(n == DEFECTS_MAX || sscanf(p, "%d %d", &defect[n].row, &defect[n].col) != 2 || defect[n].row < 0 || defect[n].col < 0)
+                err = 1;
+            n++;
+        }
+        fclose(f);
+        if(err || !defect)
+        {
+            free(defect);
+            return 1;
+        }
+        /* sorted, the defects of an image come in memory order */
+        qsort(defect, n, sizeof(TDefect), CompareDefects);
+    }
+    free(corr->defect);
+    corr->defect = defect;
+    corr->num_defects = n;
+    strcpy(corr->defect_file, filename);
+    corr->prepared = FALSE;
+
+    return 0;
+}
+
+/* Offset of the image part in a reference, which is either of its size
+ * or covers the sensor. Returns -1 if it fits neither way.              */
+static long ReferenceOffset(const TReference * ref, INT width, INT height, INT row, INT col)
+{
+    if(ref->width == width && ref->height == height)
+        return 0;
+    if(ref->width >= col + width && ref->height >= row + height)
+        return (long)row * ref->width + col;
+
+    return -1;
+}
+
+/* A reference pixel at depth significant bits.                          */
+static UINT ReferencePixel(const TReference * ref, long offset, INT width, INT i, INT top)
+{
+    const UINT2 * p = ref->pixel + offset + (long)(i / width) * ref->width + i % width;
+
+    return ((UINT)*p * top + 32767) / 65535;
+}
+
+/* Gains that bring the bright reference, less the dark one, to its mean
+ * over the image, and the dark levels to subtract.                       */
+static INT PrepareFlatField(TCorrection * corr, INT count, INT top)
+{
+    long flat_offset = 0, dark_offset = 0;
+    double mean = 0.0, gain;
+    INT i, n = 0;
+    UINT flat;
+    void * ptr;
+
+    if(corr->flat.pixel && (flat_offset = ReferenceOffset(&corr->flat, corr->width, corr->height, corr->row, corr->col)) < 0)
+        return 1;
+    if(corr->dark.pixel && (dark_offset = ReferenceOffset(&corr->dark, corr->width, corr->height, corr->row, corr->col)) < 0)
+        return 1;
+    if(!(ptr = realloc(corr->gain, count * sizeof(UINT2))))
+        return 1;
+    corr->gain = (UINT2 *)ptr;
+    if(!(ptr = realloc(corr->offset, count * sizeof(UINT2))))
+        return 1;
+    corr->offset = (UINT2 *)ptr;
+
+    for(i = 0; i < count; i++)
+        corr->offset[i] = corr->dark.pixel ? (UINT2)ReferencePixel(&corr->dark, dark_offset, corr->width, i, top) : 0;
+    if(!corr->flat.pixel)
+    {
+        for(i = 0; i < count; i++)
+            corr->gain[i] = 1 << FLAT_FIELD_SHIFT;
+        return 0;
+    }
+
+    /* the flat differences go through the gains until they are known */
+    for(i = 0; i < count; i++)
+    {
+        flat = ReferencePixel(&corr->flat, flat_offset, corr->width, i, top);
+        corr->gain[i] = (UINT2)(flat > corr->offset[i] ? flat - corr->offset[i] : 0);
+        if(corr->gain[i])
+        {
+            mean += corr->gain[i];
+            n++;
+        }
+    }
+    mean = n ? mean / n : 1.0;
+    for(i = 0; i < count; i++)
+    {
+        gain = corr->gain[i] ? mean * (1 << FLAT_FIELD_SHIFT) / corr->gain[i] + 0.5 : 1 << FLAT_FIELD_SHIFT;
+        corr->gain[i] = (UINT2)(gain < 65535.0 ? gain : 65535.0);
+    }
+
+    return 0;
+}
+
+/* Image positions of the defects within the image part.                 */
+static INT PrepareDefects(TCorrection * corr)
+{
+    TDefect * d;
+    void * ptr;
+    INT i;
+
+    if(!(ptr = realloc(corr->defect_index, (corr->num_defects + 1) * sizeof(UINT))))
+        return 1;
+    corr->defect_index = (UINT *)ptr;
+    corr->num_active = 0;
+    for(i = 0; i < corr->num_defects; i++)
+    {
+        d = &corr->defect[i];
+        if(d->row >= corr->row && d->row < corr->row + corr->height && d->col >= corr->col && d->col < corr->col + corr->width)
+            corr->defect_index[corr->num_active++] = (UINT)(d->row - corr->row) * corr->width + (d->col - corr->col);
+    }
+
+    return 0;
+}
+
+INT CorrectionPrepare(TCorrection * corr, INT width, INT height, INT row, INT col, INT depth, HBOOL bayer)
+{
+    INT i, step = bayer ? 2 : 1;
+
+    if(corr->prepared && corr->width == width && corr->height == height && corr->row == row && corr->col == col && corr->depth == depth
+       && corr->step == step)
+        return 0;
+    corr->prepared = FALSE;
+    corr->width = width;
+    corr->height = height;
+    corr->row = row;
+    corr->col = col;
+    corr->depth = depth;
+    corr->step = step;
+
+    /* a table for another depth would map the wrong range */
+    if(corr->lut && corr->lut_depth != depth)
+        return 1;
+
+    if(corr->flat.pixel || corr->dark.pixel)
+    {
+        if(PrepareFlatField(corr, width * height, (1 << depth) - 1) != 0)
+            return 1;
+    }
+    else
+    {
+        free(corr->gain);
+        free(corr->offset);
+        corr->gain = corr->offset = NULL;
+    }
+    if(PrepareDefects(corr) != 0)
+        return 1;
+    if(corr->lut && depth == 8)
+        for(i = 0; i < 256; i++)
+            corr->lut_byte[i] = (HBYTE)corr->lut[i];
+    corr->prepared = TRUE;
+
+    return 0;
+}
+
+/* First defect at or after image position start.                       */
+static INT FirstDefect(const TCorrection * corr, UINT start)
+{
+    INT lo = 0, hi = corr->num_active, mid;
+
+    while(lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if(corr->defect_index[mid] < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Nearest pixel of the same Bayer color (or, in gray images, the next
+ * pixel) in direction dir from image position i within its row that is
+ * not a defect itself. Returns its position, or -1 if there is none.    */
+static long Neighbour(const TCorrection * corr, UINT i, INT dir)
+{
+    INT x = (INT)(i % corr->width), d;
+
+    for(;;)
+    {
+        x += dir * corr->step;
+        i += dir * corr->step;
+        if(x < 0 || x >= corr->width)
+            return -1;
+        d = FirstDefect(corr, i);
+        if(d == corr->num_active || corr->defect_index[d] != i)
+            return (long)i;
+    }
+}
+
+/* Replace a defect by the mean of its neighbours that exist (-1
+ * otherwise); a defect without any keeps its value.                      */
+static UINT Repair(INT value, INT left, INT right)
+{
+    if(left >= 0 && right >= 0)
+        return (left + right + 1) / 2;
+    if(left < 0 && right < 0)
+        return value;
+
+    return left >= 0 ? left : right;
+}
+
+void CorrectByte(TCorrection * corr, HBYTE * band, INT y, INT rows)
+{
+    UINT start = (UINT)y * corr->width, count = (UINT)rows * corr->width, k;
+    long left, right;
+    INT d;
+
+    if(corr->gain)
+        FlatFieldByte(band, corr->offset + start, corr->gain + start, count);
+    for(d = FirstDefect(corr, start); d < corr->num_active && (k = corr->defect_index[d] - start) < count; d++)
+    {
+        left = Neighbour(corr, k + start, -1);
+        right = Neighbour(corr, k + start, 1);
+        band[k] = (HBYTE)Repair(band[k], left >= 0 ? band[left - start] : -1, right >= 0 ? band[right - start] : -1);
+    }
+    if(corr->lut)
+        LookupByte(band, corr->lut_byte, count);
+}
+
+void CorrectWord(TCorrection * corr, UINT2 * band, INT y, INT rows)
+{
+    UINT start = (UINT)y * corr->width, count = (UINT)rows * corr->width, k;
+    long left, right;
+    INT d;
+
+    if(corr->gain)
+        FlatFieldWord(band, corr->offset + start, corr->gain + start, count, corr->depth);
+    for(d = FirstDefect(corr, start); d < corr->num_active && (k = corr->defect_index[d] - start) < count; d++)
+    {
+        left = Neighbour(corr, k + start, -1);
+        right = Neighbour(corr, k + start, 1);
+        band[k] = (UINT2)Repair(band[k], left >= 0 ? band[left - start] : -1, right >= 0 ? band[right - start] : -1);
+    }
+    if(corr->lut)
+        LookupWord(band, corr->lut, count, corr->depth);
+}
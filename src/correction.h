@@ -0,0 +1,97 @@
+/** \file correction.h
+ * \brief Pixel correction stage for the NET iCube acquisition interface.
+ */
+
+#ifndef __CORRECTION_H__
+#define __CORRECTION_H__
+
+#include <Halcon.h>
+
+/* The correction is applied while frames are copied out of the capture
+ * buffers, in this order:
+ *
+ * - flat-field: the dark reference is subtracted and the result scaled
+ *   by the gain that evens out the bright reference over the image. Both
+ *   references are binary PGM images, either of the size of the image or
+ *   covering the sensor, in which case the image part is cut out at its
+ *   position;
+ * - defect pixels: each pixel of the list is replaced by the mean of its
+ *   nearest neighbours in its row that are not defects themselves: of the
+ *   same Bayer color in Bayer images, adjacent ones in gray images. The
+ *   list is a text file of "row column" sensor positions, one per line,
+ *   '#' starting a comment;
+ * - lookup table: a text file of 256, 1024 or 4096 output values, applied
+ *   to frames of 8, 10 or 12 bits respectively.                         */
+#define CORRECTION_PATH_MAX 1024
+
+typedef struct
+{
+    INT row;
+    INT col;
+} TDefect;
+
+/* A reference image, with pixels scaled to 16 bits.                     */
+typedef struct
+{
+    UINT2 * pixel;
+    INT width;
+    INT height;
+} TReference;
+
+typedef struct
+{
+    char lut_file[CORRECTION_PATH_MAX];
+    char flat_file[CORRECTION_PATH_MAX];
+    char dark_file[CORRECTION_PATH_MAX];
+    char defect_file[CORRECTION_PATH_MAX];
+    UINT2 * lut;
+    INT lut_depth;
+    TReference flat;
+    TReference dark;
+    TDefect * defect;
+    INT num_defects;
+    /* prepared for the image part and depth last corrected */
+    HBOOL prepared;
+    INT width;
+    INT height;
+    INT row;
+    INT col;
+    INT depth;
+    INT step;
+    UINT2 * gain;
+    UINT2 * offset;
+    UINT * defect_index;
+    INT num_active;
+    HBYTE lut_byte[256];
+} TCorrection;
+
+/* Prepare an empty correction.                                           */
+extern void CorrectionInit(TCorrection * corr);
+
+/* Release everything loaded and prepared.                                */
+extern void CorrectionFree(TCorrection * corr);
+
+/* Load the lookup table, flat-field reference, dark reference or defect
+ * list from a file, or drop it if the file name is empty. Returns 0 on
+ * success; on failure, the previous one is kept.                         */
+extern INT CorrectionLoadLut(TCorrection * corr, const char * filename);
+extern INT CorrectionLoadFlat(TCorrection * corr, const char * filename);
+extern INT CorrectionLoadDark(TCorrection * corr, const char * filename);
+extern INT CorrectionLoadDefects(TCorrection * corr, const char * filename);
+
+/* Whether anything is loaded.                                            */
+extern HBOOL CorrectionLoaded(const TCorrection * corr);
+
+/* Prepare the correction of an image part of the sensor, with pixels of
+ * depth significant bits (8 to 12), holding a Bayer mosaic or gray
+ * values. Only does work when the part, the depth or the kind changed.
+ * Returns 0 on success, or 1 if memory ran out, a reference does not
+ * cover the image or the lookup table is for another depth.              */
+extern INT CorrectionPrepare(TCorrection * corr, INT width, INT height, INT row, INT col, INT depth, HBOOL bayer);
+
+/* Correct rows y to y + rows of the prepared image in place, 8-bit or
+ * 16-bit pixels; band points to row y.                                   */
+extern void CorrectByte(TCorrection * corr, HBYTE * band, INT y, INT rows);
+extern void CorrectWord(TCorrection * corr, UINT2 * band, INT y, INT rows);
+
+#endif /* __CORRECTION_H__ */
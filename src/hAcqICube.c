@@ -7,34 +7,464 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <strings.h>
-#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <Halcon.h>
 #include <hlib/CIOFrameGrab.h>
 
 #include "netusbcamextra.h"
+#include "pixelkernels.h"
+#include "recorder.h"
+#include "playback.h"
+#include "correction.h"
 #include <NETUSBCAM_API.h>
 
 #define FG_PARAM_INDEX "index"
 #define FG_PARAM_GRAB_TIMEOUT "grab_timeout"
+#define FG_PARAM_BUFFER_COUNT "buffer_count"
+#define FG_PARAM_BURST_LENGTH "burst_length"
+#define FG_PARAM_TRIGGER_MODE "trigger_mode"
+#define FG_PARAM_TRIGGER_AHEAD "trigger_ahead"
+#define FG_PARAM_QUEUE_OVERFLOW "queue_overflow"
+#define FG_PARAM_GRAB_MODE "grab_mode"
+#define FG_PARAM_QUEUE_LEVEL "queue_level"
+#define FG_PARAM_ROI "roi"
+#define FG_PARAM_ROI_DEFERRED "roi_deferred"
+#define FG_PARAM_APPLY_ROI "apply_roi"
+#ifndef FG_PARAM_VOLATILE
+#define FG_PARAM_VOLATILE "volatile"
+#endif
+#define FG_PARAM_BINNING "binning"
+#define FG_PARAM_BINNING_MODE "binning_mode"
+#define FG_PARAM_AVERAGE_FRAMES "average_frames"
+#define FG_PARAM_AVERAGE_OUTPUT "average_output"
+#define FG_PARAM_CORRECTION "correction"
+#define FG_PARAM_LUT_FILE "lut_file"
+#define FG_PARAM_FLAT_FIELD_FILE "flat_field_file"
+#define FG_PARAM_DARK_FIELD_FILE "dark_field_file"
+#define FG_PARAM_DEFECT_FILE "defect_file"
+#define FG_PARAM_SYNC_GROUP "sync_group"
+#define FG_PARAM_SYNC_MATCH "sync_match"
+#define FG_PARAM_SYNC_TOLERANCE "sync_tolerance"
+#define FG_PARAM_SYNC_SKEW "sync_skew"
+#define FG_PARAM_RECORD "record"
+#define FG_PARAM_RECORD_FILE "record_file"
+#define FG_PARAM_RECORD_FRAMES "record_frames"
+#define FG_PARAM_RECORD_DROPPED "record_dropped"
+#define FG_PARAM_PLAYBACK_TIMING "playback_timing"
+#define FG_PARAM_PLAYBACK_RATE "playback_rate"
+#define FG_PARAM_PLAYBACK_LOOP "playback_loop"
+#define FG_PARAM_PLAYBACK_FRAMES "playback_frames"
 #define FG_PARAM_EXPOSURE_TIME "exposure_time"
 #define FG_PARAM_EXPOSURE_AUTO "exposure_auto"
 #define FG_PARAM_EXPOSURE_TARGET "exposure_target"
 #define FG_PARAM_EXPOSURE_MSEC "exposure_msec"
+#define FG_PARAM_BRIGHTNESS "brightness"
+#define FG_PARAM_CONTRAST "contrast"
+#define FG_PARAM_GAMMA "gamma"
+#define FG_PARAM_FLIP_VERTICAL "flip_vertical"
+#define FG_PARAM_FLIP_HORIZONTAL "flip_horizontal"
+#define FG_PARAM_WHITE_BALANCE "white_balance"
+#define FG_PARAM_RED "red"
+#define FG_PARAM_GREEN "green"
+#define FG_PARAM_BLUE "blue"
+#define FG_PARAM_BLACK_LEVEL "black_level"
+#define FG_PARAM_GAIN "gain"
+#define FG_PARAM_COLOR "color"
+#define FG_PARAM_PLL "pll"
+#define FG_PARAM_STROBE_LENGTH "strobe_length"
+#define FG_PARAM_STROBE_DELAY "strobe_delay"
+#define FG_PARAM_TRIGGER_DELAY "trigger_delay"
+#define FG_PARAM_SATURATION "saturation"
+#define FG_PARAM_COLOR_MACHINE "color_machine"
+#define FG_PARAM_TRIGGER_INVERT "trigger_invert"
+#define FG_PARAM_MEASURE_FIELD_AE "measure_field_ae"
+#define FG_PARAM_SHUTTER "shutter"
+#define FG_PARAM_DEFECT_COR "defect_correction"
+#define FG_PARAM_WHITE_BALANCE_AUTO "white_balance_auto"
+#define FG_PARAM_GAIN_AUTO "gain_auto"
+#define FG_PARAM_REFRESH_REGISTERS "refresh_registers"
+#define FG_PARAM_BAYER_PATTERN "bayer_pattern"
+#define FG_PARAM_BAYER_INTERPOLATION "bayer_interpolation"
+#define FG_PARAM_CONVERSION_TIME "conversion_time"
+#define FG_PARAM_FRAME_SEQUENCE "frame_sequence"
+#define FG_PARAM_FRAME_TRIGGER "frame_trigger"
+#define FG_PARAM_FRAME_TIMESTAMP "frame_timestamp"
+#define FG_PARAM_FRAME_AGE "frame_age"
+#define FG_PARAM_STATISTICS "statistics"
+#define FG_PARAM_FRAME_HISTOGRAM "frame_histogram"
+#define FG_PARAM_FRAME_MEAN "frame_mean"
+#define FG_PARAM_FRAME_MIN "frame_min"
+#define FG_PARAM_FRAME_MAX "frame_max"
+#define FG_PARAM_FRAME_SATURATED "frame_saturated"
+#define FG_PARAM_STATISTICS_WINDOW "statistics_window"
+#define FG_PARAM_HOST_EXPOSURE "host_exposure"
+#define FG_PARAM_HOST_EXPOSURE_TARGET "host_exposure_target"
+#define FG_PARAM_HOST_EXPOSURE_STEP "host_exposure_step"
+#define FG_PARAM_HOST_EXPOSURE_SETTLE "host_exposure_settle"
+#define FG_PARAM_FRAMES_RECEIVED "frames_received"
+#define FG_PARAM_FRAMES_DELIVERED "frames_delivered"
+#define FG_PARAM_FRAMES_DROPPED "frames_dropped"
+#define FG_PARAM_GRAB_TIMEOUTS "grab_timeouts"
+#define FG_PARAM_LATENCY_AVG "latency_avg"
+#define FG_PARAM_LATENCY_MAX "latency_max"
+#define FG_PARAM_RESET_STATISTICS "reset_statistics"
 
 #define FG_PARAM_GRAB_TIMEOUT_RANGE "grab_timeout_range"
+#define FG_PARAM_BUFFER_COUNT_RANGE "buffer_count_range"
+#define FG_PARAM_BURST_LENGTH_RANGE "burst_length_range"
+#define FG_PARAM_AVERAGE_FRAMES_RANGE "average_frames_range"
+#define FG_PARAM_SYNC_GROUP_RANGE "sync_group_range"
 #define FG_PARAM_EXPOSURE_TIME_RANGE "exposure_time_range"
 #define FG_PARAM_EXPOSURE_TARGET_RANGE "exposure_target_range"
+#define FG_PARAM_BRIGHTNESS_RANGE "brightness_range"
+#define FG_PARAM_CONTRAST_RANGE "contrast_range"
+#define FG_PARAM_GAMMA_RANGE "gamma_range"
+#define FG_PARAM_FLIP_VERTICAL_RANGE "flip_vertical_range"
+#define FG_PARAM_FLIP_HORIZONTAL_RANGE "flip_horizontal_range"
+#define FG_PARAM_WHITE_BALANCE_RANGE "white_balance_range"
+#define FG_PARAM_RED_RANGE "red_range"
+#define FG_PARAM_GREEN_RANGE "green_range"
+#define FG_PARAM_BLUE_RANGE "blue_range"
+#define FG_PARAM_BLACK_LEVEL_RANGE "black_level_range"
+#define FG_PARAM_GAIN_RANGE "gain_range"
+#define FG_PARAM_COLOR_RANGE "color_range"
+#define FG_PARAM_PLL_RANGE "pll_range"
+#define FG_PARAM_STROBE_LENGTH_RANGE "strobe_length_range"
+#define FG_PARAM_STROBE_DELAY_RANGE "strobe_delay_range"
+#define FG_PARAM_TRIGGER_DELAY_RANGE "trigger_delay_range"
+#define FG_PARAM_SATURATION_RANGE "saturation_range"
+#define FG_PARAM_COLOR_MACHINE_RANGE "color_machine_range"
+#define FG_PARAM_TRIGGER_INVERT_RANGE "trigger_invert_range"
+#define FG_PARAM_MEASURE_FIELD_AE_RANGE "measure_field_ae_range"
+#define FG_PARAM_SHUTTER_RANGE "shutter_range"
+#define FG_PARAM_DEFECT_COR_RANGE "defect_correction_range"
 
+#define FG_PARAM_VOLATILE_VALUES "volatile_values"
+#define FG_PARAM_STATISTICS_VALUES "statistics_values"
+#define FG_PARAM_HOST_EXPOSURE_VALUES "host_exposure_values"
+#define FG_PARAM_BINNING_VALUES "binning_values"
+#define FG_PARAM_BINNING_MODE_VALUES "binning_mode_values"
+#define FG_PARAM_AVERAGE_OUTPUT_VALUES "average_output_values"
+#define FG_PARAM_CORRECTION_VALUES "correction_values"
+#define FG_PARAM_SYNC_MATCH_VALUES "sync_match_values"
+#define FG_PARAM_RECORD_VALUES "record_values"
+#define FG_PARAM_PLAYBACK_TIMING_VALUES "playback_timing_values"
+#define FG_PARAM_PLAYBACK_LOOP_VALUES "playback_loop_values"
+#define FG_PARAM_TRIGGER_MODE_VALUES "trigger_mode_values"
+#define FG_PARAM_TRIGGER_AHEAD_VALUES "trigger_ahead_values"
+#define FG_PARAM_QUEUE_OVERFLOW_VALUES "queue_overflow_values"
+#define FG_PARAM_GRAB_MODE_VALUES "grab_mode_values"
+#define FG_PARAM_ROI_DEFERRED_VALUES "roi_deferred_values"
+#define FG_PARAM_COLOR_SPACE_VALUES "color_space_values"
+#define FG_PARAM_BITS_PER_CHANNEL_VALUES "bits_per_channel_values"
+#define FG_PARAM_BAYER_PATTERN_VALUES "bayer_pattern_values"
+#define FG_PARAM_BAYER_INTERPOLATION_VALUES "bayer_interpolation_values"
 #define FG_PARAM_EXPOSURE_AUTO_VALUES "exposure_auto_values"
+#define FG_PARAM_WHITE_BALANCE_AUTO_VALUES "white_balance_auto_values"
+#define FG_PARAM_GAIN_AUTO_VALUES "gain_auto_values"
 
 #define FG_PARAM_INDEX_DESCR "index_description"
 #define FG_PARAM_GRAB_TIMEOUT_DESCR "grab_timeout_description"
+#define FG_PARAM_BUFFER_COUNT_DESCR "buffer_count_description"
+#define FG_PARAM_BURST_LENGTH_DESCR "burst_length_description"
+#define FG_PARAM_TRIGGER_MODE_DESCR "trigger_mode_description"
+#define FG_PARAM_TRIGGER_AHEAD_DESCR "trigger_ahead_description"
+#define FG_PARAM_QUEUE_OVERFLOW_DESCR "queue_overflow_description"
+#define FG_PARAM_GRAB_MODE_DESCR "grab_mode_description"
+#define FG_PARAM_QUEUE_LEVEL_DESCR "queue_level_description"
+#define FG_PARAM_ROI_DESCR "roi_description"
+#define FG_PARAM_ROI_DEFERRED_DESCR "roi_deferred_description"
+#define FG_PARAM_APPLY_ROI_DESCR "apply_roi_description"
+#define FG_PARAM_VOLATILE_DESCR "volatile_description"
+#define FG_PARAM_BINNING_DESCR "binning_description"
+#define FG_PARAM_BINNING_MODE_DESCR "binning_mode_description"
+#define FG_PARAM_AVERAGE_FRAMES_DESCR "average_frames_description"
+#define FG_PARAM_AVERAGE_OUTPUT_DESCR "average_output_description"
+#define FG_PARAM_CORRECTION_DESCR "correction_description"
+#define FG_PARAM_LUT_FILE_DESCR "lut_file_description"
+#define FG_PARAM_FLAT_FIELD_FILE_DESCR "flat_field_file_description"
+#define FG_PARAM_DARK_FIELD_FILE_DESCR "dark_field_file_description"
+#define FG_PARAM_DEFECT_FILE_DESCR "defect_file_description"
+#define FG_PARAM_SYNC_GROUP_DESCR "sync_group_description"
+#define FG_PARAM_SYNC_MATCH_DESCR "sync_match_description"
+#define FG_PARAM_SYNC_TOLERANCE_DESCR "sync_tolerance_description"
+#define FG_PARAM_SYNC_SKEW_DESCR "sync_skew_description"
+#define FG_PARAM_RECORD_DESCR "record_description"
+#define FG_PARAM_RECORD_FILE_DESCR "record_file_description"
+#define FG_PARAM_RECORD_FRAMES_DESCR "record_frames_description"
+#define FG_PARAM_RECORD_DROPPED_DESCR "record_dropped_description"
+#define FG_PARAM_PLAYBACK_TIMING_DESCR "playback_timing_description"
+#define FG_PARAM_PLAYBACK_RATE_DESCR "playback_rate_description"
+#define FG_PARAM_PLAYBACK_LOOP_DESCR "playback_loop_description"
+#define FG_PARAM_PLAYBACK_FRAMES_DESCR "playback_frames_description"
 #define FG_PARAM_EXPOSURE_TIME_DESCR "exposure_time_description"
 #define FG_PARAM_EXPOSURE_AUTO_DESCR "exposure_auto_description"
 #define FG_PARAM_EXPOSURE_TARGET_DESCR "exposure_target_description"
 #define FG_PARAM_EXPOSURE_MSEC_DESCR "exposure_msec_description"
+#define FG_PARAM_BRIGHTNESS_DESCR "brightness_description"
+#define FG_PARAM_CONTRAST_DESCR "contrast_description"
+#define FG_PARAM_GAMMA_DESCR "gamma_description"
+#define FG_PARAM_FLIP_VERTICAL_DESCR "flip_vertical_description"
+#define FG_PARAM_FLIP_HORIZONTAL_DESCR "flip_horizontal_description"
+#define FG_PARAM_WHITE_BALANCE_DESCR "white_balance_description"
+#define FG_PARAM_RED_DESCR "red_description"
+#define FG_PARAM_GREEN_DESCR "green_description"
+#define FG_PARAM_BLUE_DESCR "blue_description"
+#define FG_PARAM_BLACK_LEVEL_DESCR "black_level_description"
+#define FG_PARAM_GAIN_DESCR "gain_description"
+#define FG_PARAM_COLOR_DESCR "color_description"
+#define FG_PARAM_PLL_DESCR "pll_description"
+#define FG_PARAM_STROBE_LENGTH_DESCR "strobe_length_description"
+#define FG_PARAM_STROBE_DELAY_DESCR "strobe_delay_description"
+#define FG_PARAM_TRIGGER_DELAY_DESCR "trigger_delay_description"
+#define FG_PARAM_SATURATION_DESCR "saturation_description"
+#define FG_PARAM_COLOR_MACHINE_DESCR "color_machine_description"
+#define FG_PARAM_TRIGGER_INVERT_DESCR "trigger_invert_description"
+#define FG_PARAM_MEASURE_FIELD_AE_DESCR "measure_field_ae_description"
+#define FG_PARAM_SHUTTER_DESCR "shutter_description"
+#define FG_PARAM_DEFECT_COR_DESCR "defect_correction_description"
+#define FG_PARAM_WHITE_BALANCE_AUTO_DESCR "white_balance_auto_description"
+#define FG_PARAM_GAIN_AUTO_DESCR "gain_auto_description"
+#define FG_PARAM_REFRESH_REGISTERS_DESCR "refresh_registers_description"
+#define FG_PARAM_COLOR_SPACE_DESCR "color_space_description"
+#define FG_PARAM_BITS_PER_CHANNEL_DESCR "bits_per_channel_description"
+#define FG_PARAM_BAYER_PATTERN_DESCR "bayer_pattern_description"
+#define FG_PARAM_BAYER_INTERPOLATION_DESCR "bayer_interpolation_description"
+#define FG_PARAM_CONVERSION_TIME_DESCR "conversion_time_description"
+#define FG_PARAM_FRAME_SEQUENCE_DESCR "frame_sequence_description"
+#define FG_PARAM_FRAME_TRIGGER_DESCR "frame_trigger_description"
+#define FG_PARAM_FRAME_TIMESTAMP_DESCR "frame_timestamp_description"
+#define FG_PARAM_FRAME_AGE_DESCR "frame_age_description"
+#define FG_PARAM_STATISTICS_DESCR "statistics_description"
+#define FG_PARAM_FRAME_HISTOGRAM_DESCR "frame_histogram_description"
+#define FG_PARAM_FRAME_MEAN_DESCR "frame_mean_description"
+#define FG_PARAM_FRAME_MIN_DESCR "frame_min_description"
+#define FG_PARAM_FRAME_MAX_DESCR "frame_max_description"
+#define FG_PARAM_FRAME_SATURATED_DESCR "frame_saturated_description"
+#define FG_PARAM_STATISTICS_WINDOW_DESCR "statistics_window_description"
+#define FG_PARAM_HOST_EXPOSURE_DESCR "host_exposure_description"
+#define FG_PARAM_HOST_EXPOSURE_TARGET_DESCR "host_exposure_target_description"
+#define FG_PARAM_HOST_EXPOSURE_STEP_DESCR "host_exposure_step_description"
+#define FG_PARAM_HOST_EXPOSURE_SETTLE_DESCR "host_exposure_settle_description"
+#define FG_PARAM_FRAMES_RECEIVED_DESCR "frames_received_description"
+#define FG_PARAM_FRAMES_DELIVERED_DESCR "frames_delivered_description"
+#define FG_PARAM_FRAMES_DROPPED_DESCR "frames_dropped_description"
+#define FG_PARAM_GRAB_TIMEOUTS_DESCR "grab_timeouts_description"
+#define FG_PARAM_LATENCY_AVG_DESCR "latency_avg_description"
+#define FG_PARAM_LATENCY_MAX_DESCR "latency_max_description"
+#define FG_PARAM_RESET_STATISTICS_DESCR "reset_statistics_description"
+
+/* Additional parameters reported by FGInfo                               */
+static char * params[] = {
+    FG_PARAM_INDEX,
+    FG_PARAM_GRAB_TIMEOUT,
+    FG_PARAM_BUFFER_COUNT,
+    FG_PARAM_BURST_LENGTH,
+    FG_PARAM_TRIGGER_MODE,
+    FG_PARAM_TRIGGER_AHEAD,
+    FG_PARAM_QUEUE_OVERFLOW,
+    FG_PARAM_GRAB_MODE,
+    FG_PARAM_QUEUE_LEVEL,
+    FG_PARAM_ROI,
+    FG_PARAM_ROI_DEFERRED,
+    FG_PARAM_APPLY_ROI,
+    FG_PARAM_VOLATILE,
+    FG_PARAM_BINNING,
+    FG_PARAM_BINNING_MODE,
+    FG_PARAM_AVERAGE_FRAMES,
+    FG_PARAM_AVERAGE_OUTPUT,
+    FG_PARAM_CORRECTION,
+    FG_PARAM_LUT_FILE,
+    FG_PARAM_FLAT_FIELD_FILE,
+    FG_PARAM_DARK_FIELD_FILE,
+    FG_PARAM_DEFECT_FILE,
+    FG_PARAM_SYNC_GROUP,
+    FG_PARAM_SYNC_MATCH,
+    FG_PARAM_SYNC_TOLERANCE,
+    FG_PARAM_SYNC_SKEW,
+    FG_PARAM_RECORD,
+    FG_PARAM_RECORD_FILE,
+    FG_PARAM_RECORD_FRAMES,
+    FG_PARAM_RECORD_DROPPED,
+    FG_PARAM_PLAYBACK_TIMING,
+    FG_PARAM_PLAYBACK_RATE,
+    FG_PARAM_PLAYBACK_LOOP,
+    FG_PARAM_PLAYBACK_FRAMES,
+    FG_PARAM_EXPOSURE_TIME,
+    FG_PARAM_EXPOSURE_AUTO,
+    FG_PARAM_EXPOSURE_TARGET,
+    FG_PARAM_EXPOSURE_MSEC,
+    FG_PARAM_BRIGHTNESS,
+    FG_PARAM_CONTRAST,
+    FG_PARAM_GAMMA,
+    FG_PARAM_FLIP_VERTICAL,
+    FG_PARAM_FLIP_HORIZONTAL,
+    FG_PARAM_WHITE_BALANCE,
+    FG_PARAM_RED,
+    FG_PARAM_GREEN,
+    FG_PARAM_BLUE,
+    FG_PARAM_BLACK_LEVEL,
+    FG_PARAM_GAIN,
+    FG_PARAM_COLOR,
+    FG_PARAM_PLL,
+    FG_PARAM_STROBE_LENGTH,
+    FG_PARAM_STROBE_DELAY,
+    FG_PARAM_TRIGGER_DELAY,
+    FG_PARAM_SATURATION,
+    FG_PARAM_COLOR_MACHINE,
+    FG_PARAM_TRIGGER_INVERT,
+    FG_PARAM_MEASURE_FIELD_AE,
+    FG_PARAM_SHUTTER,
+    FG_PARAM_DEFECT_COR,
+    FG_PARAM_WHITE_BALANCE_AUTO,
+    FG_PARAM_GAIN_AUTO,
+    FG_PARAM_REFRESH_REGISTERS,
+    FG_PARAM_COLOR_SPACE,
+    FG_PARAM_BITS_PER_CHANNEL,
+    FG_PARAM_BAYER_PATTERN,
+    FG_PARAM_BAYER_INTERPOLATION,
+    FG_PARAM_CONVERSION_TIME,
+    FG_PARAM_FRAME_SEQUENCE,
+    FG_PARAM_FRAME_TRIGGER,
+    FG_PARAM_FRAME_TIMESTAMP,
+    FG_PARAM_FRAME_AGE,
+    FG_PARAM_STATISTICS,
+    FG_PARAM_FRAME_HISTOGRAM,
+    FG_PARAM_FRAME_MEAN,
+    FG_PARAM_FRAME_MIN,
+    FG_PARAM_FRAME_MAX,
+    FG_PARAM_FRAME_SATURATED,
+    FG_PARAM_STATISTICS_WINDOW,
+    FG_PARAM_HOST_EXPOSURE,
+    FG_PARAM_HOST_EXPOSURE_TARGET,
+    FG_PARAM_HOST_EXPOSURE_STEP,
+    FG_PARAM_HOST_EXPOSURE_SETTLE,
+    FG_PARAM_FRAMES_RECEIVED,
+    FG_PARAM_FRAMES_DELIVERED,
+    FG_PARAM_FRAMES_DROPPED,
+    FG_PARAM_GRAB_TIMEOUTS,
+    FG_PARAM_LATENCY_AVG,
+    FG_PARAM_LATENCY_MAX,
+    FG_PARAM_RESET_STATISTICS
+};
+
+static char * params_ro[] = {
+    FG_PARAM_INDEX,
+    FG_PARAM_QUEUE_LEVEL,
+    FG_PARAM_SYNC_SKEW,
+    FG_PARAM_RECORD_FRAMES,
+    FG_PARAM_RECORD_DROPPED,
+    FG_PARAM_PLAYBACK_FRAMES,
+    FG_PARAM_EXPOSURE_MSEC,
+    FG_PARAM_CONVERSION_TIME,
+    FG_PARAM_FRAME_SEQUENCE,
+    FG_PARAM_FRAME_TRIGGER,
+    FG_PARAM_FRAME_TIMESTAMP,
+    FG_PARAM_FRAME_AGE,
+    FG_PARAM_FRAME_HISTOGRAM,
+    FG_PARAM_FRAME_MEAN,
+    FG_PARAM_FRAME_MIN,
+    FG_PARAM_FRAME_MAX,
+    FG_PARAM_FRAME_SATURATED,
+    FG_PARAM_FRAMES_RECEIVED,
+    FG_PARAM_FRAMES_DELIVERED,
+    FG_PARAM_FRAMES_DROPPED,
+    FG_PARAM_GRAB_TIMEOUTS,
+    FG_PARAM_LATENCY_AVG,
+    FG_PARAM_LATENCY_MAX
+};
+
+static char * params_wo[] = {
+    FG_PARAM_REFRESH_REGISTERS,
+    FG_PARAM_APPLY_ROI,
+    FG_PARAM_RESET_STATISTICS
+};
+
+#define NUM_PARAMS (INT)(sizeof(params) / sizeof(params[0]))
+#define NUM_PARAMS_RO (INT)(sizeof(params_ro) / sizeof(params_ro[0]))
+#define NUM_PARAMS_WO (INT)(sizeof(params_wo) / sizeof(params_wo[0]))
+
+static char * bayer_patterns[] = {"bayer_rg", "bayer_gr", "bayer_bg", "bayer_gb"};
+static char * bayer_interpolations[] = {"bilinear", "gradient"};
+static char * trigger_modes[] = {"free_run", "software", "hardware"};
+static char * queue_overflows[] = {"drop_oldest", "drop_newest"};
+static char * grab_modes[] = {"oldest", "newest", "next"};
+static char * binning_modes[] = {"average", "decimate"};
+static char * average_outputs[] = {"frame", "uint2"};
+static char * sync_matches[] = {"trigger", "timestamp"};
+static char * playback_timings[] = {"recorded", "fixed", "max"};
+
+/* Camera registers exposed as parameters                                 */
+typedef struct
+{
+    INT reg;
+    char * name;
+    char * range;
+    char * descr;
+    char * descr_text;
+    char * auto_name;
+    char * auto_values;
+    char * auto_descr;
+    char * auto_descr_text;
+} TFGRegisterParam;
+
+static TFGRegisterParam register_params[] = {
+    {REG_BRIGHTNESS, FG_PARAM_BRIGHTNESS, FG_PARAM_BRIGHTNESS_RANGE, FG_PARAM_BRIGHTNESS_DESCR, "Brightness.",
+     NULL, NULL, NULL, NULL},
+    {REG_CONTRAST, FG_PARAM_CONTRAST, FG_PARAM_CONTRAST_RANGE, FG_PARAM_CONTRAST_DESCR, "Contrast.",
+     NULL, NULL, NULL, NULL},
+    {REG_GAMMA, FG_PARAM_GAMMA, FG_PARAM_GAMMA_RANGE, FG_PARAM_GAMMA_DESCR, "Gamma correction.",
+     NULL, NULL, NULL, NULL},
+    {REG_FLIPPED_V, FG_PARAM_FLIP_VERTICAL, FG_PARAM_FLIP_VERTICAL_RANGE, FG_PARAM_FLIP_VERTICAL_DESCR, "Flip the image vertically.",
+     NULL, NULL, NULL, NULL},
+    {REG_FLIPPED_H, FG_PARAM_FLIP_HORIZONTAL, FG_PARAM_FLIP_HORIZONTAL_RANGE, FG_PARAM_FLIP_HORIZONTAL_DESCR, "Flip the image horizontally.",
+     NULL, NULL, NULL, NULL},
+    {REG_WHITE_BALANCE, FG_PARAM_WHITE_BALANCE, FG_PARAM_WHITE_BALANCE_RANGE, FG_PARAM_WHITE_BALANCE_DESCR, "White balance.",
+     FG_PARAM_WHITE_BALANCE_AUTO, FG_PARAM_WHITE_BALANCE_AUTO_VALUES, FG_PARAM_WHITE_BALANCE_AUTO_DESCR, "Toggle automatic white balance."},
+    {REG_EXPOSURE_TIME, FG_PARAM_EXPOSURE_TIME, FG_PARAM_EXPOSURE_TIME_RANGE, FG_PARAM_EXPOSURE_TIME_DESCR, "Exposure time.",
+     FG_PARAM_EXPOSURE_AUTO, FG_PARAM_EXPOSURE_AUTO_VALUES, FG_PARAM_EXPOSURE_AUTO_DESCR, "Toggle automatic exposure."},
+    {REG_EXPOSURE_TARGET, FG_PARAM_EXPOSURE_TARGET, FG_PARAM_EXPOSURE_TARGET_RANGE, FG_PARAM_EXPOSURE_TARGET_DESCR, "Target brightness for automatic exposure.",
+     NULL, NULL, NULL, NULL},
+    {REG_RED, FG_PARAM_RED, FG_PARAM_RED_RANGE, FG_PARAM_RED_DESCR, "Red channel gain.",
+     NULL, NULL, NULL, NULL},
+    {REG_GREEN, FG_PARAM_GREEN, FG_PARAM_GREEN_RANGE, FG_PARAM_GREEN_DESCR, "Green channel gain.",
+     NULL, NULL, NULL, NULL},
+    {REG_BLUE, FG_PARAM_BLUE, FG_PARAM_BLUE_RANGE, FG_PARAM_BLUE_DESCR, "Blue channel gain.",
+     NULL, NULL, NULL, NULL},
+    {REG_BLACKLEVEL, FG_PARAM_BLACK_LEVEL, FG_PARAM_BLACK_LEVEL_RANGE, FG_PARAM_BLACK_LEVEL_DESCR, "Black level offset.",
+     NULL, NULL, NULL, NULL},
+    {REG_GAIN, FG_PARAM_GAIN, FG_PARAM_GAIN_RANGE, FG_PARAM_GAIN_DESCR, "Global gain.",
+     FG_PARAM_GAIN_AUTO, FG_PARAM_GAIN_AUTO_VALUES, FG_PARAM_GAIN_AUTO_DESCR, "Toggle automatic gain."},
+    {REG_COLOR, FG_PARAM_COLOR, FG_PARAM_COLOR_RANGE, FG_PARAM_COLOR_DESCR, "Color processing on the camera.",
+     NULL, NULL, NULL, NULL},
+    {REG_PLL, FG_PARAM_PLL, FG_PARAM_PLL_RANGE, FG_PARAM_PLL_DESCR, "Pixel clock.",
+     NULL, NULL, NULL, NULL},
+    {REG_STROBE_LENGTH, FG_PARAM_STROBE_LENGTH, FG_PARAM_STROBE_LENGTH_RANGE, FG_PARAM_STROBE_LENGTH_DESCR, "Strobe output pulse length.",
+     NULL, NULL, NULL, NULL},
+    {REG_STROBE_DELAY, FG_PARAM_STROBE_DELAY, FG_PARAM_STROBE_DELAY_RANGE, FG_PARAM_STROBE_DELAY_DESCR, "Strobe output delay.",
+     NULL, NULL, NULL, NULL},
+    {REG_TRIGGER_DELAY, FG_PARAM_TRIGGER_DELAY, FG_PARAM_TRIGGER_DELAY_RANGE, FG_PARAM_TRIGGER_DELAY_DESCR, "Delay between hardware trigger and exposure.",
+     NULL, NULL, NULL, NULL},
+    {REG_SATURATION, FG_PARAM_SATURATION, FG_PARAM_SATURATION_RANGE, FG_PARAM_SATURATION_DESCR, "Color saturation.",
+     NULL, NULL, NULL, NULL},
+    {REG_COLOR_MACHINE, FG_PARAM_COLOR_MACHINE, FG_PARAM_COLOR_MACHINE_RANGE, FG_PARAM_COLOR_MACHINE_DESCR, "Color machine vision mode.",
+     NULL, NULL, NULL, NULL},
+    {REG_TRIGGER_INVERT, FG_PARAM_TRIGGER_INVERT, FG_PARAM_TRIGGER_INVERT_RANGE, FG_PARAM_TRIGGER_INVERT_DESCR, "Invert the hardware trigger input.",
+     NULL, NULL, NULL, NULL},
+    {REG_MEASURE_FIELD_AE, FG_PARAM_MEASURE_FIELD_AE, FG_PARAM_MEASURE_FIELD_AE_RANGE, FG_PARAM_MEASURE_FIELD_AE_DESCR, "Measurement field for automatic exposure.",
+     NULL, NULL, NULL, NULL},
+    {REG_SHUTTER, FG_PARAM_SHUTTER, FG_PARAM_SHUTTER_RANGE, FG_PARAM_SHUTTER_DESCR, "Shutter mode.",
+     NULL, NULL, NULL, NULL},
+    {REG_DEFECT_COR, FG_PARAM_DEFECT_COR, FG_PARAM_DEFECT_COR_RANGE, FG_PARAM_DEFECT_COR_DESCR, "Defect pixel correction on the camera.",
+     NULL, NULL, NULL, NULL}
+};
+
+#define NUM_REGISTERS (INT)(sizeof(register_params) / sizeof(register_params[0]))
 
 /* Use this macro to display error messages                               */
 #define MY_PRINT_ERROR_MESSAGE(ERR) { \
@@ -43,11 +473,210 @@
 extern HUserExport Herror FGInit(Hproc_handle proc_id, FGClass * fg);
 extern HLibExport Herror IOPrintErrorMessage(char * err);
 
+#define BUFFER_COUNT_MAX 64
+#define BUFFER_COUNT_DEFAULT 4
+#define BURST_LENGTH_MAX 16
+#define BINNING_MAX 4
+
+/* Rows converted at a time while counting statistics or averaging
+ * frames, a multiple of the binning factors and of the pixel groups of
+ * the packed formats                                                     */
+#define CONVERT_BAND 16
+
+/* Bins of the frame_histogram parameter                                  */
+#define HISTOGRAM_BINS 256
+
+/* Host exposure control: the relative deviation of the mean from the
+ * target left alone, and the fraction of saturated pixels from which the
+ * mean is too low to go by                                              */
+#define EXPOSURE_TOLERANCE 0.03
+#define EXPOSURE_SATURATED 0.01
+#define EXPOSURE_TARGET_DEFAULT 128.0
+#define EXPOSURE_STEP_DEFAULT 2.0
+#define EXPOSURE_SETTLE_DEFAULT 1
+
+/* Largest difference in milliseconds between the arrival times of the
+ * frames of a group grab matched by timestamp                            */
+#define SYNC_TOLERANCE_DEFAULT 5.0
+
+/* Trigger modes, in the order of trigger_modes                         */
+enum {
+    TRIGGER_FREE_RUN = 0,
+    TRIGGER_SOFTWARE,
+    TRIGGER_HARDWARE
+};
+
+/* Queue overflow policies, in the order of queue_overflows             */
+enum {
+    OVERFLOW_DROP_OLDEST = 0,
+    OVERFLOW_DROP_NEWEST
+};
+
+/* Frames taken by synchronous grabs, in the order of grab_modes         */
+enum {
+    GRAB_OLDEST = 0,
+    GRAB_NEWEST,
+    GRAB_NEXT
+};
+
+/* Pixel types of averaged images, in the order of average_outputs      */
+enum {
+    AVERAGE_FRAME = 0,
+    AVERAGE_UINT2
+};
+
+/* Matching of the frames of a group grab, in the order of sync_matches */
+enum {
+    SYNC_TRIGGER = 0,
+    SYNC_TIMESTAMP
+};
+
+/* ROI components, in the order of the roi parameter                    */
+enum {
+    ROI_WIDTH = 0,
+    ROI_HEIGHT,
+    ROI_ROW,
+    ROI_COL
+};
+
+/* Parameters derived from a camera register                            */
+enum {
+    REGISTER_VALUE = 0,
+    REGISTER_RANGE,
+    REGISTER_DESCR,
+    REGISTER_AUTO,
+    REGISTER_AUTO_VALUES,
+    REGISTER_AUTO_DESCR
+};
+
+/* Cached state of a camera register                                     */
+typedef struct
+{
+    HBOOL valid;
+    HBOOL auto_valid;
+    unsigned long value;
+    INT automatic;
+    PARAM_PROPERTY range;
+} TFGRegister;
+
+/* Frame buffer states                                                    */
+enum {
+    BUFFER_FREE = 0,
+    BUFFER_FILLING,
+    BUFFER_FILLED,
+    BUFFER_GRABBING
+};
+
+/* Wrap-safe comparison of frame sequence numbers                         */
+#define SEQ_BEFORE(A, B) ((INT)((A) - (B)) < 0)
+
+/* Buffer states, frame counters and frame statistics are shared without
+ * a lock between the camera callback, the only producer, and the
+ * consumer: grabs, parameter changes and closing, from any thread, which
+ * take turns on the lock of the instance (of its group, in a group). The
+ * recorder only reads the buffers the callback pinned for it, and group
+ * conversion threads only those their group grab took.                  */
+#define ATOMIC_LOAD(X) __atomic_load_n(&(X), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(X, V) __atomic_store_n(&(X), (V), __ATOMIC_RELEASE)
+#define ATOMIC_INC(X) __atomic_add_fetch(&(X), 1, __ATOMIC_RELAXED)
+
+typedef struct
+{
+    HBYTE * image;
+    UINT size;
+    UINT length;
+    INT state;
+    INT pinned;
+    UINT seq;
+    double time;
+} TFGBuffer;
+
+/* Acquisition statistics                                                 */
+typedef struct
+{
+    UINT last_seq;
+    double last_time;
+    double last_age;
+    UINT received;
+    UINT delivered;
+    UINT dropped;
+    UINT timeouts;
+    double latency_sum;
+    double latency_max;
+} TFGStatistics;
+
+/* Lock serving its takers in the order they came, so that a stream of
+ * grabs cannot starve parameter changes, nor the other way round.        */
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t turn;
+    UINT next;
+    UINT serving;
+} TFGLock;
+
 typedef struct
 {
     INT index;
     INT grab_timeout;
-    HBYTE * image;
+    INT buffer_count;
+    INT burst_length;
+    UINT buffer_size;
+    TFGBuffer buffer[BUFFER_COUNT_MAX];
+    UINT seq;
+    UINT done;
+    INT waiting;
+    HBOOL async_started;
+    UINT async_seq;
+    INT trigger_mode;
+    HBOOL trigger_ahead;
+    UINT trigger_seq;
+    UINT trigger_due;
+    double trigger_time;
+    INT queue_overflow;
+    INT grab_mode;
+    HBOOL roi_deferred;
+    INT roi[4];
+    TFGRegister reg[NUM_REGISTERS];
+    HBOOL volatile_mode;
+    INT delivered;
+    INT binning;
+    INT binning_mode;
+    INT average_frames;
+    INT average_output;
+    HBOOL correction;
+    TCorrection corr;
+    HBYTE * scratch;
+    UINT scratch_size;
+    INT sync_group;
+    INT sync_match;
+    double sync_tolerance;
+    double sync_skew;
+    pthread_t worker;
+    HBOOL worker_running;
+    UINT work_posted;
+    UINT work_done;
+    void * work;
+    HBOOL statistics;
+    TPixelStatistics pixel_stats;
+    INT stats_window[4];
+    HBOOL host_exposure;
+    double exposure_target;
+    double exposure_step;
+    INT exposure_settle;
+    UINT exposure_seq;
+    Himage data_image[2 * BURST_LENGTH_MAX];
+    INT data_channels[2];
+    TRecorder recorder;
+    char record_file[RECORD_PATH_MAX];
+    TPlayback player;
+    HBOOL color;
+    INT bayer_pattern;
+    INT bayer_interpolation;
+    double conversion_time;
+    TFGStatistics stats;
+    TFGLock lock;
+    HBOOL open;
 } TFGInstance;
 
 static FGClass * fgClass;
@@ -56,6 +685,11 @@ static TFGInstance FGInst[FG_MAX_INST];
 static INT num_instances = 0;
 static INT num_devices = 0;
 
+/* Serializes the grabs of each synchronization group with each other and
+ * with parameter changes and closing of its members, which may stop a
+ * camera or reallocate its buffers.                                      */
+static TFGLock group_lock[FG_MAX_INST + 1];
+
 #define NUM_MODES 9
 static int modelist[NUM_MODES][2] = {
     {320, 240},
@@ -72,682 +706,3538 @@ static int modelist[NUM_MODES][2] = {
 #define GRAB_TIMEOUT_MAX 10000
 #define GRAB_TIMEOUT_DEFAULT 1000
 
-static pthread_mutex_t image_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t image_ready = PTHREAD_COND_INITIALIZER;
+/* Monotonic time in milliseconds.                                       */
+static double Now(void)
+{
+    struct timespec ts;
 
-static INT ImageComplete(void * buffer, UINT bsize, void * context)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Find the filled buffer holding the oldest frame (-1 if none), and its
+ * sequence number.                                                       */
+static INT OldestBuffer(TFGInstance * currInst, UINT * oldest_seq)
 {
-    pthread_mutex_lock(&image_mutex);
+    INT i, oldest = -1;
+    UINT seq;
 
-    memcpy(context, buffer, bsize);
+    for(i = 0; i < currInst->buffer_count; i++)
+    {
+        if(ATOMIC_LOAD(currInst->buffer[i].state) != BUFFER_FILLED)
+            continue;
+        seq = ATOMIC_LOAD(currInst->buffer[i].seq);
+        if(oldest < 0 || SEQ_BEFORE(seq, *oldest_seq))
+        {
+            oldest = i;
+            *oldest_seq = seq;
+        }
+    }
 
-    pthread_cond_signal(&image_ready);
-    pthread_mutex_unlock(&image_mutex);
+    return oldest;
+}
 
-    return 0;
+/* Find the filled buffer holding the newest frame (-1 if none), and its
+ * sequence number.                                                       */
+static INT NewestBuffer(TFGInstance * currInst, UINT * newest_seq)
+{
+    INT i, newest = -1;
+    UINT seq;
+
+    for(i = 0; i < currInst->buffer_count; i++)
+    {
+        if(ATOMIC_LOAD(currInst->buffer[i].state) != BUFFER_FILLED)
+            continue;
+        seq = ATOMIC_LOAD(currInst->buffer[i].seq);
+        if(newest < 0 || SEQ_BEFORE(*newest_seq, seq))
+        {
+            newest = i;
+            *newest_seq = seq;
+        }
+    }
+
+    return newest;
 }
 
-static INT AllocateImage(FGInstance * fginst)
+/* Claim a buffer for a new frame: a free one or, if the queue is full and
+ * overflow drops the oldest frame, the oldest filled one (-1 to discard
+ * the new frame). A filled buffer may be taken by the grabbing thread
+ * at the same time, so the claim is retried until it holds. Buffers a
+ * burst, average or group grab holds are not in the queue: when they
+ * leave no filled buffer to overwrite, the new frame is discarded even
+ * if overflow drops the oldest; so it is while the recorder still has
+ * to copy the oldest frame, or every free buffer.                        */
+static INT ClaimBuffer(TFGInstance * currInst)
 {
-    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
-    void * ptr;
+    INT i, state;
+    UINT seq;
+
+    for(;;)
+    {
+        for(i = 0; i < currInst->buffer_count; i++)
+        {
+            /* only the callback pins buffers, so an unpinned one stays so */
+            if(ATOMIC_LOAD(currInst->buffer[i].pinned))
+                continue;
+            state = BUFFER_FREE;
+            if(__atomic_compare_exchange_n(&currInst->buffer[i].state, &state, BUFFER_FILLING, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return i;
+        }
+        if(currInst->queue_overflow == OVERFLOW_DROP_NEWEST || (i = OldestBuffer(currInst, &seq)) < 0 ||
+           ATOMIC_LOAD(currInst->buffer[i].pinned))
+        {
+            ATOMIC_INC(currInst->stats.dropped);
+            return -1;
+        }
+        state = BUFFER_FILLED;
+        if(__atomic_compare_exchange_n(&currInst->buffer[i].state, &state, BUFFER_FILLING, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            ATOMIC_INC(currInst->stats.dropped);
+            return i;
+        }
+    }
+}
+
+/* Check whether a new frame would find a free buffer, so that playback
+ * as fast as the grabs take frames overwrites none of them.             */
+static HBOOL BufferReady(void * context)
+{
+    TFGInstance * currInst = (TFGInstance *)context;
+    INT i;
+
+    for(i = 0; i < currInst->buffer_count; i++)
+        if(ATOMIC_LOAD(currInst->buffer[i].state) == BUFFER_FREE && !ATOMIC_LOAD(currInst->buffer[i].pinned))
+            return TRUE;
+
+    return FALSE;
+}
 
-    NETUSBCAM_GetResolution(currInst->index, &fginst->image_width, &fginst->image_height, &fginst->start_col, &fginst->start_row);
+static INT ImageComplete(void * buffer, UINT bsize, void * context)
+{
+    TFGInstance * currInst = (TFGInstance *)context;
+    TFGBuffer * buf;
+    UINT seq, length = bsize < currInst->buffer_size ? bsize : currInst->buffer_size;
+    double time = Now();
+    INT i;
+
+    /* the callback is the only writer of the frame counters */
+    seq = currInst->seq + 1;
+    ATOMIC_STORE(currInst->seq, seq);
+    ATOMIC_INC(currInst->stats.received);
 
-    if(currInst->image)
+    if((i = ClaimBuffer(currInst)) >= 0)
     {
-        ptr = realloc(currInst->image, fginst->image_width * fginst->image_height * sizeof(HBYTE));
-        if(ptr)
-            currInst->image = (HBYTE *)ptr;
-        else
-            return 1;
+        buf = &currInst->buffer[i];
+        ATOMIC_STORE(buf->seq, seq);
+        buf->time = time;
+        buf->length = length;
+        memcpy(buf->image, buffer, length);
+        ATOMIC_STORE(buf->state, BUFFER_FILLED);
     }
+
+    /* publish the frame (or its loss), then wake a waiting grab */
+    __atomic_store_n(&currInst->done, seq, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&currInst->waiting, __ATOMIC_SEQ_CST) > 0)
+        syscall(SYS_futex, &currInst->done, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+
+    /* the recorder copies the frame from the ring buffer, pinned until
+       the writer thread has it, so the callback copies it only once */
+    if(i >= 0)
+        RecorderPushPinned(&currInst->recorder, buf->image, length, seq, time, &buf->pinned);
     else
+        RecorderPush(&currInst->recorder, buffer, length, seq, time);
+
+    return 0;
+}
+
+static void InitLock(TFGLock * lock)
+{
+    pthread_mutex_init(&lock->mutex, NULL);
+    pthread_cond_init(&lock->turn, NULL);
+    lock->next = 0;
+    lock->serving = 0;
+}
+
+/* Wait for the turn of the caller, sleeping meanwhile.                  */
+static void TakeLock(TFGLock * lock)
+{
+    UINT ticket;
+
+    pthread_mutex_lock(&lock->mutex);
+    ticket = lock->next++;
+    while(lock->serving != ticket)
+        pthread_cond_wait(&lock->turn, &lock->mutex);
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+static void GiveLock(TFGLock * lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+    lock->serving++;
+    pthread_cond_broadcast(&lock->turn);
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+/* Take the consumer lock of an instance: that of its synchronization
+ * group, or its own outside a group. If the instance changed group while
+ * the caller waited, the lock of the new one is taken instead.           */
+static TFGLock * LockInstance(TFGInstance * currInst)
+{
+    TFGLock * lock;
+    INT group;
+
+    for(;;)
     {
-        currInst->image = (HBYTE *)malloc(fginst->image_width * fginst->image_height * sizeof(HBYTE));
+        group = ATOMIC_LOAD(currInst->sync_group);
+        lock = group > 0 ? &group_lock[group] : &currInst->lock;
+        TakeLock(lock);
+        if(ATOMIC_LOAD(currInst->sync_group) == group)
+            return lock;
+        GiveLock(lock);
     }
+}
 
-    return 0;
+/* End the conversion thread an instance runs for group grabs. Called
+ * with the consumer lock held, so that no conversion is pending.        */
+static void StopWorker(TFGInstance * currInst)
+{
+    if(!currInst->worker_running)
+        return;
+    ATOMIC_STORE(currInst->worker_running, FALSE);
+    ATOMIC_STORE(currInst->work_posted, currInst->work_posted + 1);
+    syscall(SYS_futex, &currInst->work_posted, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    pthread_join(currInst->worker, NULL);
 }
 
-static Herror FGOpen(Hproc_handle proc_id, FGInstance * fginst)
+static void FreeImage(TFGInstance * currInst)
 {
-    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
     INT i;
-    UINT mode, nmodes = NUM_MODES;
-    UINT modes[NUM_MODES];
 
-    if(fginst->port >= num_devices)
+    StopWorker(currInst);
+    for(i = 0; i < BUFFER_COUNT_MAX; i++)
     {
-        MY_PRINT_ERROR_MESSAGE("invalid device index")
-        return H_ERR_FGNI;
+        free(currInst->buffer[i].image);
+        currInst->buffer[i].image = NULL;
+        currInst->buffer[i].size = 0;
+        currInst->buffer[i].state = BUFFER_FREE;
     }
-    currInst->index = fginst->port;
-    if(NETUSBCAM_Open(currInst->index) != 0)
+    free(currInst->scratch);
+    currInst->scratch = NULL;
+    currInst->scratch_size = 0;
+}
+
+/* Return the buffer held by the last volatile image to the ring.        */
+static void ReleaseDelivered(TFGInstance * currInst)
+{
+    if(currInst->delivered >= 0)
+        ATOMIC_STORE(currInst->buffer[currInst->delivered].state, BUFFER_FREE);
+    currInst->delivered = -1;
+}
+
+/* Find the filled buffer holding frame seq (-1 if none).                */
+static INT FindBuffer(TFGInstance * currInst, UINT seq)
+{
+    INT i;
+
+    for(i = 0; i < currInst->buffer_count; i++)
+        if(ATOMIC_LOAD(currInst->buffer[i].state) == BUFFER_FILLED && ATOMIC_LOAD(currInst->buffer[i].seq) == seq)
+            return i;
+
+    return -1;
+}
+
+/* Take a filled buffer holding frame seq out of the ring. Fails if the
+ * callback overwrote it since it was found.                             */
+static HBOOL TakeBuffer(TFGInstance * currInst, INT i, UINT seq)
+{
+    INT state = BUFFER_FILLED;
+
+    if(!__atomic_compare_exchange_n(&currInst->buffer[i].state, &state, BUFFER_GRABBING, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return FALSE;
+    if(currInst->buffer[i].seq != seq)
     {
-        MY_PRINT_ERROR_MESSAGE("open camera failed")
-        return H_ERR_FGNI;
+        ATOMIC_STORE(currInst->buffer[i].state, BUFFER_FILLED);
+        return FALSE;
     }
-    num_instances++;
 
-    if(fginst->horizontal_resolution > 0 && fginst->vertical_resolution > 0)
+    return TRUE;
+}
+
+/* Take the oldest filled buffer (-1 if none), discarding frames up to
+ * and including sequence number seq if after is set, and frames older
+ * than maxDelay milliseconds if it is non-negative.                      */
+static INT TakeOldest(TFGInstance * currInst, HBOOL after, UINT seq, double maxDelay)
+{
+    INT i;
+    UINT oldest;
+
+    while((i = OldestBuffer(currInst, &oldest)) >= 0)
     {
-        NETUSBCAM_GetModeList(currInst->index, &nmodes, modes);
-        for(i = 0; i < nmodes; i++)
+        if(!TakeBuffer(currInst, i, oldest))
+            continue;
+        if((after && !SEQ_BEFORE(seq, oldest)) || (maxDelay >= 0.0 && Now() - currInst->buffer[i].time > maxDelay))
         {
-            if(fginst->horizontal_resolution == modelist[modes[i]][0] && fginst->vertical_resolution == modelist[modes[i]][1])
-            {
-                NETUSBCAM_SetMode(currInst->index, modes[i]);
-                fginst->horizontal_resolution = modelist[modes[i]][0];
-                fginst->vertical_resolution = modelist[modes[i]][1];
-                break;
-            }
+            ATOMIC_STORE(currInst->buffer[i].state, BUFFER_FREE);
+            ATOMIC_INC(currInst->stats.dropped);
+            continue;
         }
-    }
-    else
-    {
-        NETUSBCAM_GetMode(currInst->index, &mode);
-        fginst->horizontal_resolution = modelist[mode][0];
-        fginst->vertical_resolution = modelist[mode][1];
+        return i;
     }
 
-    if(fginst->image_width && fginst->image_height)
+    return -1;
+}
+
+/* Take count consecutive frames starting with the oldest filled buffer
+ * (see WaitBuffers). Frames up to done are final, so a gap among them
+ * means a frame was lost; returns FALSE if frames are still to come.    */
+static HBOOL TakeBuffers(TFGInstance * currInst, HBOOL after, UINT seq, double maxDelay, INT count, UINT done, INT * index)
+{
+    INT i, n, k;
+    TFGBuffer * buf;
+
+    for(;;)
     {
-        if(NETUSBCAM_SetResolution(currInst->index, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
+        if((i = TakeOldest(currInst, after, seq, maxDelay)) < 0)
+            return FALSE;
+        buf = &currInst->buffer[i];
+
+        /* a burst must not have gaps: if one of the following frames
+           was lost, start over with the next oldest frame */
+        index[0] = i;
+        for(n = 1; n < count; n++)
         {
-            MY_PRINT_ERROR_MESSAGE("setting ROI failed")
+            index[n] = FindBuffer(currInst, buf->seq + n);
+            if(index[n] < 0 || !TakeBuffer(currInst, index[n], buf->seq + n))
+                break;
+        }
+        if(n == count)
+            return TRUE;
+        for(k = 1; k < n; k++)
+            ATOMIC_STORE(currInst->buffer[index[k]].state, BUFFER_FILLED);
+        if(SEQ_BEFORE(done, buf->seq + n))
+        {
+            ATOMIC_STORE(buf->state, BUFFER_FILLED);
+            return FALSE;
         }
+        ATOMIC_STORE(buf->state, BUFFER_FREE);
+        ATOMIC_INC(currInst->stats.dropped);
     }
+}
 
-    if(AllocateImage(fginst) != 0)
-        return H_ERR_MEM;
+/* Sleep until the callback finishes the frame after done, or for at most
+ * timeout milliseconds.                                                  */
+static void WaitFrame(TFGInstance * currInst, UINT done, double timeout)
+{
+    struct timespec ts;
 
-    if(fginst->external_trigger)
-        NETUSBCAM_SetTrigger(currInst->index, TRIG_HW_START);
-    else
+    ts.tv_sec = (time_t)(timeout / 1000.0);
+    ts.tv_nsec = (long)((timeout - ts.tv_sec * 1000.0) * 1000000.0);
+
+    /* the callback only makes the wake-up call while someone waits; the
+       futex itself rechecks done against frames finished meanwhile */
+    __atomic_add_fetch(&currInst->waiting, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &currInst->done, FUTEX_WAIT_PRIVATE, done, &ts, NULL, 0);
+    __atomic_sub_fetch(&currInst->waiting, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Wait for count consecutive frames starting with the oldest filled
+ * buffer, and mark them as being grabbed. If after is set, frames up to
+ * and including sequence number seq are discarded; if maxDelay is
+ * non-negative, so are frames older than maxDelay milliseconds. Returns
+ * FALSE on timeout.                                                      */
+static HBOOL WaitBuffers(TFGInstance * currInst, HBOOL after, UINT seq, double maxDelay, INT count, INT * index)
+{
+    double timeout = Now() + currInst->grab_timeout;
+    UINT done;
+
+    ReleaseDelivered(currInst);
+
+    for(;;)
     {
-        //NETUSBCAM_SetTrigger(currInst->index, TRIG_STOP);
-        //NETUSBCAM_SetTrigger(currInst->index, TRIG_SW_START);
+        /* every frame counted as done is visible in the buffers */
+        done = __atomic_load_n(&currInst->done, __ATOMIC_SEQ_CST);
+        if(TakeBuffers(currInst, after, seq, maxDelay, count, done, index))
+            return TRUE;
+        if(Now() >= timeout)
+            break;
+        WaitFrame(currInst, done, timeout - Now());
     }
+    currInst->stats.timeouts++;
+
+    return FALSE;
+}
+
+/* Clear the frame counters and latency statistics. The callback may be
+ * counting at the same time.                                            */
+static void ResetStatistics(TFGStatistics * stats)
+{
+    stats->last_seq = 0;
+    stats->last_time = 0.0;
+    stats->last_age = 0.0;
+    ATOMIC_STORE(stats->received, 0);
+    stats->delivered = 0;
+    ATOMIC_STORE(stats->dropped, 0);
+    stats->timeouts = 0;
+    stats->latency_sum = 0.0;
+    stats->latency_max = 0.0;
+}
+
+/* Record the metadata of a delivered frame.                              */
+static void FrameDelivered(TFGInstance * currInst, INT i)
+{
+    TFGStatistics * stats = &currInst->stats;
+
+    stats->last_seq = currInst->buffer[i].seq;
+    stats->last_time = currInst->buffer[i].time;
+    stats->last_age = Now() - stats->last_time;
+    stats->delivered++;
+    stats->latency_sum += stats->last_age;
+    if(stats->last_age > stats->latency_max)
+        stats->latency_max = stats->last_age;
+}
 
-    NETUSBCAM_SetCallback(currInst->index, CALLBACK_RAW, &ImageComplete, (void *)currInst->image);
+/* Clip the statistics window to the image; an empty window stands for
+ * the whole image.                                                       */
+static void GetStatisticsWindow(FGInstance * fginst, INT * win)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT * w = currInst->stats_window;
 
-    if(NETUSBCAM_Start(currInst->index) != 0)
+    if(w[ROI_WIDTH] <= 0 || w[ROI_HEIGHT] <= 0)
     {
-        MY_PRINT_ERROR_MESSAGE("start camera failed")
-        return H_ERR_FGF;
+        win[ROI_WIDTH] = fginst->image_width;
+        win[ROI_HEIGHT] = fginst->image_height;
+        win[ROI_ROW] = win[ROI_COL] = 0;
+        return;
     }
+    win[ROI_ROW] = w[ROI_ROW] < fginst->image_height ? w[ROI_ROW] : fginst->image_height;
+    win[ROI_COL] = w[ROI_COL] < fginst->image_width ? w[ROI_COL] : fginst->image_width;
+    win[ROI_HEIGHT] = w[ROI_HEIGHT] < fginst->image_height - win[ROI_ROW] ? w[ROI_HEIGHT] : fginst->image_height - win[ROI_ROW];
+    win[ROI_WIDTH] = w[ROI_WIDTH] < fginst->image_width - win[ROI_COL] ? w[ROI_WIDTH] : fginst->image_width - win[ROI_COL];
+}
 
-    return H_MSG_OK;
+/* Count the part of rows y to y + rows of a full resolution frame, of
+ * 16-bit pixels if words is set, that lies in the statistics window.
+ * band points to row y.                                                  */
+static void CountRows(FGInstance * fginst, const void * band, HBOOL words, INT * win, INT y, INT rows)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT top = y > win[ROI_ROW] ? y : win[ROI_ROW];
+    INT bottom = y + rows < win[ROI_ROW] + win[ROI_HEIGHT] ? y + rows : win[ROI_ROW] + win[ROI_HEIGHT];
+    INT offset = (top - y) * fginst->image_width + win[ROI_COL];
+
+    if(bottom <= top || win[ROI_WIDTH] <= 0)
+        return;
+    if(words)
+        StatisticsWord((const UINT2 *)band + offset, win[ROI_WIDTH], bottom - top, fginst->image_width, &currInst->pixel_stats);
+    else
+        StatisticsByte((const HBYTE *)band + offset, win[ROI_WIDTH], bottom - top, fginst->image_width, &currInst->pixel_stats);
 }
 
-static Herror FGClose(Hproc_handle proc_id, FGInstance * fginst)
+/* Count a whole 8-bit frame.                                             */
+static void CountFrame(FGInstance * fginst, const HBYTE * frame)
 {
     TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT win[4];
+
+    ClearStatistics(&currInst->pixel_stats, 8);
+    GetStatisticsWindow(fginst, win);
+    CountRows(fginst, frame, FALSE, win, 0, fginst->image_height);
+}
 
-    if(NETUSBCAM_Stop(currInst->index) != 0)
+/* Scratch memory of at least size bytes, kept between grabs.            */
+static void * Scratch(TFGInstance * currInst, UINT size)
+{
+    void * ptr;
+
+    if(currInst->scratch_size < size)
     {
-        MY_PRINT_ERROR_MESSAGE("stop camera failed")
-        return H_ERR_FGF;
+        ptr = realloc(currInst->scratch, size);
+        if(!ptr)
+            return NULL;
+        currInst->scratch = (HBYTE *)ptr;
+        currInst->scratch_size = size;
     }
 
-    if(NETUSBCAM_Close(currInst->index) != 0)
+    return currInst->scratch;
+}
+
+/* Prepare the correction of the current image with pixels of depth
+ * significant bits; correct tells whether there is any to apply.        */
+static Herror PrepareCorrection(FGInstance * fginst, INT depth, HBOOL * correct)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+
+    *correct = currInst->correction && CorrectionLoaded(&currInst->corr);
+    if(*correct && CorrectionPrepare(&currInst->corr, fginst->image_width, fginst->image_height, fginst->start_row, fginst->start_col,
+                                     depth, currInst->color) != 0)
     {
-        MY_PRINT_ERROR_MESSAGE("close camera failed")
-        return H_ERR_FGCLOSE;
+        MY_PRINT_ERROR_MESSAGE("correction does not fit the image")
+        return H_ERR_FGF;
     }
-    num_instances--;
 
     return H_MSG_OK;
 }
 
-static Herror FGGrabStartAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay)
+/* Bayer pattern of the image, from that of the sensor and the position
+ * of the image on it: an odd column swaps the colors within the rows,
+ * an odd row swaps the rows.                                             */
+static INT ImagePattern(FGInstance * fginst)
 {
-    return H_ERR_FGASYNC;
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT pattern = currInst->bayer_pattern;
+
+    if(fginst->start_col & 1)
+        pattern ^= 1;
+    if(fginst->start_row & 1)
+        pattern ^= 3;
+
+    return pattern;
 }
 
-static Herror FGGrab(Hproc_handle proc_id, FGInstance * fginst, Himage * image, INT * num_image)
+/* Demosaic a grabbed buffer into a new three-channel HALCON image. The
+ * statistics, if requested, count the raw Bayer frame, and the
+ * correction applies to it before demosaicing.                           */
+static Herror DeliverColor(Hproc_handle proc_id, FGInstance * fginst, INT i, HBOOL statistics, Himage * image, INT * num_image)
 {
     TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
-    Herror err;
-    INT save, to;
-    struct timespec timeout;
+    const HBYTE * raw = currInst->buffer[i].image;
+    Herror err = H_MSG_OK;
+    HBOOL correct;
+    INT save, ch;
+    double start;
+    HBYTE * frame = NULL;
+
+    HCkP(PrepareCorrection(fginst, 8, &correct));
+    /* the corrected frame, taken before any image is */
+    if(correct && !(frame = (HBYTE *)Scratch(currInst, fginst->image_width * fginst->image_height)))
+        return H_ERR_MEM;
 
     HReadSysComInfo(proc_id, HGInitNewImage, &save);
     HWriteSysComInfo(proc_id, HGInitNewImage, FALSE);
-    *num_image = 1;
-    err = HNewImage(proc_id, &image[0], BYTE_IMAGE, fginst->image_width, fginst->image_height);
-    if(err != H_MSG_OK)
+    *num_image = 3;
+    for(ch = 0; ch < 3 && err == H_MSG_OK; ch++)
+        err = HNewImage(proc_id, &image[ch], BYTE_IMAGE, fginst->image_width, fginst->image_height);
+    HWriteSysComInfo(proc_id, HGInitNewImage, save);
+
+    if(err == H_MSG_OK && statistics)
+        CountFrame(fginst, currInst->buffer[i].image);
+    if(err == H_MSG_OK && frame)
     {
-        HWriteSysComInfo(proc_id, HGInitNewImage, save);
-        return err;
+        memcpy(frame, raw, fginst->image_width * fginst->image_height);
+        CorrectByte(&currInst->corr, frame, 0, fginst->image_height);
+        raw = frame;
+    }
+    if(err == H_MSG_OK)
+    {
+        start = Now();
+        Demosaic(raw, fginst->image_width, fginst->image_height, ImagePattern(fginst), currInst->bayer_interpolation,
+                 image[0].pixel.b, image[1].pixel.b, image[2].pixel.b);
+        currInst->conversion_time = Now() - start;
     }
 
-    pthread_mutex_lock(&image_mutex);
-    //NETUSBCAM_SetTrigger(currInst->index, TRIG_SW_DO);
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec += currInst->grab_timeout / 1000;
-    timeout.tv_nsec += (long)(currInst->grab_timeout % 1000) * 1000000L;
-    timeout.tv_sec += timeout.tv_nsec / 1000000000L;
-    timeout.tv_nsec %= 1000000000L;
-    to = pthread_cond_timedwait(&image_ready, &image_mutex, &timeout);
-    if(!to)
-        memcpy((void *)image[0].pixel.b, (void *)currInst->image, fginst->image_width * fginst->image_height);
-    pthread_mutex_unlock(&image_mutex);
-
-    if(to)
-        return H_ERR_FGTIMEOUT;
-
-    return H_MSG_OK;
+    return err;
 }
 
-static Herror FGGrabAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay, Himage * image, INT * num_image)
+/* Raw format of a frame of length bytes above 8 bits per channel, told
+ * apart by its size. Returns -1 if the size matches no format, or if the
+ * camera delivers fewer bits than bits_per_channel: an 8-bit frame is
+ * not widened into a deeper image.                                       */
+static INT WideFormat(FGInstance * fginst, UINT length)
 {
-    return H_ERR_FGASYNC;
+    INT format = RawFormat(length, fginst->image_width * fginst->image_height);
+
+    if(format < 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("unexpected raw frame size")
+        return -1;
+    }
+    if(RawBits(format, fginst->bits_per_channel) < fginst->bits_per_channel)
+    {
+        MY_PRINT_ERROR_MESSAGE("camera delivers fewer bits than bits_per_channel")
+        return -1;
+    }
+
+    return format;
 }
 
-static Herror FGInfo(Hproc_handle proc_id, INT queryType, char ** info, Hcpar ** values, INT * numValues)
+/* Convert grabbed buffer i into a HALCON image, reduced by factor in
+ * both directions. With statistics, the frame is converted in bands of
+ * rows, each counted at full resolution while it is still in the cache.
+ * Only the statistics window is counted. The correction applies to each
+ * band after the statistics, and before reduction.                       */
+static Herror ConvertBuffer(FGInstance * fginst, INT i, INT factor, HBOOL statistics, Himage * image)
 {
-    Hcpar *val;
-    INT i;
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    const HBYTE * raw = currInst->buffer[i].image;
+    INT width = fginst->image_width, height = fginst->image_height;
+    INT band = CONVERT_BAND, format = RAW_8, rows, y, win[4];
+    HBOOL correct;
+    HBYTE * scratch = NULL;
 
-    switch(queryType)
+    if(fginst->bits_per_channel > 8 && (format = WideFormat(fginst, currInst->buffer[i].length)) < 0)
+        return H_ERR_FGF;
+    HCkP(PrepareCorrection(fginst, fginst->bits_per_channel, &correct));
+    GetStatisticsWindow(fginst, win);
+    if(statistics)
+        ClearStatistics(&currInst->pixel_stats, fginst->bits_per_channel);
+    if(!statistics && !correct)
+        band = height;
+    /* a reduced frame is corrected before the reduction */
+    if(correct && factor > 1 && !(scratch = (HBYTE *)Scratch(currInst, band * width)))
+        return H_ERR_MEM;
+
+    for(y = 0; y < height; y += band)
     {
-        case FG_QUERY_GENERAL:
-            *info = "HALCON image acquisition interface for NET iCube.";
-            *values = NULL;
-            *numValues = 0;
-            break;
-        case FG_QUERY_DEFAULTS:
-            *info = "Default values (as used for open_framegrabber).";
-            HCkP(HFgGetDefaults(proc_id, fgClass, values, numValues));
-            break;
-        case FG_QUERY_PARAMETERS:
-            *info = "Additional parameters for this image acquisition interface.";
-            HCkP(HAlloc(proc_id, (size_t)(6 * sizeof(Hcpar)), &val));
-            val[0].par.s = FG_PARAM_INDEX;
-            val[1].par.s = FG_PARAM_GRAB_TIMEOUT;
-            val[2].par.s = FG_PARAM_EXPOSURE_TIME;
-            val[3].par.s = FG_PARAM_EXPOSURE_AUTO;
-            val[4].par.s = FG_PARAM_EXPOSURE_TARGET;
-            val[5].par.s = FG_PARAM_EXPOSURE_MSEC;
-            for(i = 0; i < 6; i++)
-                val[i].type = STRING_PAR;
-            *values = val;
-            *numValues = 6;
-            break;
-        case FG_QUERY_PARAMETERS_RO:
-            *info = "Additional read-only parameters for this interface.";
-            HCkP(HAlloc(proc_id, (size_t)(2 * sizeof(Hcpar)), &val));
-            val[0].par.s = FG_PARAM_INDEX;
-            val[1].par.s = FG_PARAM_EXPOSURE_MSEC;
-            for(i = 0; i < 2; i++)
-                val[i].type = STRING_PAR;
-            *values = val;
-            *numValues = 2;
-            break;
-        case FG_QUERY_PARAMETERS_WO:
-            *info = "Additional write-only parameters for this interface.";
-            *values = NULL;
-            *numValues = 0;
-            break;
-        case FG_QUERY_REVISION:
-            *info = "Current interface revision.";
-            HCkP(HAlloc(proc_id, (size_t)(sizeof(Hcpar)), &val));
-            val[0].par.s = INTERFACE_REVISION;
-            val[0].type = STRING_PAR;
-            *values = val;
-            *numValues = 1;
-            break;
-        case FG_QUERY_CAMERA_TYPE:
-            *info = "Name of the camera description file or 'default'.";
-            *values = NULL;
-            *numValues = 0;
-            break;
-        case FG_QUERY_PORT:
-            *info = "List of available camera device indices.";
-            HCkP(HAlloc(proc_id, (size_t)(num_devices * sizeof(Hcpar)), &val));
-            for(i = 0; i < num_devices; i++)
-            {
-                val[i].par.l = i;
-                val[i].type = LONG_PAR;
-            }
-            *values = val;
-            *numValues = num_devices;
-            break;
-        case FG_QUERY_EXT_TRIGGER:
-            *info = "Value list for ExternalTrigger parameter.";
-            HCkP(HAlloc(proc_id, (size_t)(2 * sizeof(*val)), &val));
-            val[0].par.s = "false";
-            val[0].type = STRING_PAR;
-            val[1].par.s = "true";
-            val[1].type = STRING_PAR;
-            *values = val;
-            *numValues = 2;
-            break;
-        case FG_QUERY_HORIZONTAL_RESOLUTION:
-            *info = "Supported HorizontalResolution values.";
-            HCkP(HAlloc(proc_id, (size_t)(NUM_MODES * sizeof(*val)), &val));
-            for(i = 0; i < NUM_MODES; i++)
+        rows = height - y < band ? height - y : band;
+        if(fginst->bits_per_channel > 8)
+        {
+            UnpackWord(raw + RawSize(format, y * width), format, rows * width, fginst->bits_per_channel, image->pixel.u + y * width);
+            if(statistics)
+                CountRows(fginst, image->pixel.u + y * width, TRUE, win, y, rows);
+            if(correct)
+                CorrectWord(&currInst->corr, image->pixel.u + y * width, y, rows);
+            continue;
+        }
+        if(statistics)
+            CountRows(fginst, raw + y * width, FALSE, win, y, rows);
+        if(scratch)
+        {
+            memcpy(scratch, raw + y * width, rows * width);
+            CorrectByte(&currInst->corr, scratch, y, rows);
+            Reduce(scratch, width, rows, factor, currInst->binning_mode, image->pixel.b + y / factor * (width / factor));
+        }
+        else if(factor > 1)
+            Reduce(raw + y * width, width, rows, factor, currInst->binning_mode, image->pixel.b + y / factor * (width / factor));
+        else
+        {
+            memcpy((void *)(image->pixel.b + y * width), (void *)(raw + y * width), rows * width);
+            if(correct)
+                CorrectByte(&currInst->corr, image->pixel.b + y * width, y, rows);
+        }
+    }
+
+    return H_MSG_OK;
+}
+
+/* Frames taken by one grab.                                              */
+static INT GrabFrames(TFGInstance * currInst)
+{
+    return currInst->average_frames > 1 ? currInst->average_frames : currInst->burst_length;
+}
+
+/* Average count grabbed buffers into a new HALCON image of the pixel type
+ * of a frame, or of 16 significant bits with average_output uint2. The
+ * frames are summed a band of rows at a time, so that the sums stay in
+ * the cache. With statistics, the last frame is counted. The correction
+ * applies to averages of the pixel type of a frame.                      */
+static Herror DeliverAverage(Hproc_handle proc_id, FGInstance * fginst, INT * index, INT count, HBOOL statistics,
+                             Himage * image, INT * num_image)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT width = fginst->image_width, height = fginst->image_height, depth = fginst->bits_per_channel;
+    INT format = RAW_8, save, ch, rows, n, y, win[4];
+    HBOOL wide = depth > 8 || currInst->average_output == AVERAGE_UINT2, correct = FALSE;
+    const HBYTE * raw;
+    UINT2 * sum, * band;
+    Herror err;
+
+    /* a band of sums and a band of unpacked pixels */
+    if(!(sum = (UINT2 *)Scratch(currInst, 2 * CONVERT_BAND * width * sizeof(UINT2))))
+        return H_ERR_MEM;
+    if(currInst->average_output == AVERAGE_FRAME)
+        HCkP(PrepareCorrection(fginst, depth, &correct));
+    if(depth > 8 && (format = WideFormat(fginst, currInst->buffer[index[0]].length)) < 0)
+        return H_ERR_FGF;
+
+    HReadSysComInfo(proc_id, HGInitNewImage, &save);
+    HWriteSysComInfo(proc_id, HGInitNewImage, FALSE);
+    *num_image = 1;
+    err = HNewImage(proc_id, &image[0], wide ? UINT2_IMAGE : BYTE_IMAGE, width, height);
+    HWriteSysComInfo(proc_id, HGInitNewImage, save);
+    HCkP(err);
+
+    GetStatisticsWindow(fginst, win);
+    if(statistics)
+        ClearStatistics(&currInst->pixel_stats, depth);
+
+    for(y = 0; y < height; y += CONVERT_BAND)
+    {
+        rows = height - y < CONVERT_BAND ? height - y : CONVERT_BAND;
+        n = rows * width;
+        for(ch = 0; ch < count; ch++)
+        {
+            raw = currInst->buffer[index[ch]].image;
+            band = ch == 0 ? sum : sum + CONVERT_BAND * width;
+            if(depth == 8 && ch > 0)
+                AccumulateByte(raw + y * width, n, sum);
+            else
             {
-                val[i].par.l = modelist[i][0];
-                val[i].type = LONG_PAR;
+                /* the first frame starts the sums */
+                UnpackWord(raw + RawSize(format, y * width), format, n, depth, band);
+                if(ch > 0)
+                    AccumulateWord(band, n, sum);
             }
-            *values = val;
-            *numValues = NUM_MODES;
-            break;
-        case FG_QUERY_VERTICAL_RESOLUTION:
-            *info = "Supported VerticalResolution values.";
-            HCkP(HAlloc(proc_id, (size_t)(NUM_MODES * sizeof(*val)), &val));
-            for(i = 0; i < NUM_MODES; i++)
+            if(statistics && ch == count - 1)
             {
-                val[i].par.l = modelist[i][1];
-                val[i].type = LONG_PAR;
+                if(depth > 8)
+                    CountRows(fginst, band, TRUE, win, y, rows);
+                else
+                    CountRows(fginst, raw + y * width, FALSE, win, y, rows);
             }
-            *values = val;
-            *numValues = NUM_MODES;
-            break;
-        case FG_QUERY_INFO_BOARDS:
-        case FG_QUERY_BITS_PER_CHANNEL:
-        case FG_QUERY_COLOR_SPACE:
-        case FG_QUERY_DEVICE:
-        case FG_QUERY_FIELD:
-        case FG_QUERY_GENERIC:
-            *info = "Unused.";
-            *values = NULL;
-            *numValues = 0;
-            break;
-        default:
-            *info = "Unsupported query!";
-            *values = NULL;
-            *numValues = 0;
+        }
+        if(currInst->average_output == AVERAGE_UINT2)
+            AverageWord(sum, n, count, 16 - depth, image->pixel.u + y * width);
+        else if(depth > 8)
+        {
+            AverageWord(sum, n, count, 0, image->pixel.u + y * width);
+            if(correct)
+                CorrectWord(&currInst->corr, image->pixel.u + y * width, y, rows);
+        }
+        else
+        {
+            AverageByte(sum, n, count, image->pixel.b + y * width);
+            if(correct)
+                CorrectByte(&currInst->corr, image->pixel.b + y * width, y, rows);
+        }
     }
 
     return H_MSG_OK;
 }
 
-static Herror FGSetParam(Hproc_handle proc_id, FGInstance * fginst, char * param, Hcpar * value, INT num)
+/* Copy count grabbed buffers into the channels of a new HALCON image,
+ * reduced by factor in both directions. In volatile mode, a single full
+ * resolution frame is instead delivered as an image pointing directly
+ * into the buffer, which stays out of the ring until the next grab
+ * starts. With averaging, the buffers are averaged into one image. With
+ * statistics, the last frame is counted.                                 */
+static Herror DeliverBuffer(Hproc_handle proc_id, FGInstance * fginst, INT * index, INT count, INT factor, HBOOL statistics,
+                            Himage * image, INT * num_image)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    Herror err = H_MSG_OK;
+    INT i = index[0], save, ch;
+
+    if(currInst->color)
+        return DeliverColor(proc_id, fginst, i, statistics, image, num_image);
+    if(currInst->average_frames > 1)
+        return DeliverAverage(proc_id, fginst, index, count, statistics, image, num_image);
+
+    /* a corrected frame needs a copy to correct */
+    if(currInst->volatile_mode && count == 1 && factor == 1 && fginst->bits_per_channel == 8
+       && !(currInst->correction && CorrectionLoaded(&currInst->corr)))
+    {
+        *num_image = 1;
+        HCkP(HNewImagePtr(proc_id, &image[0], BYTE_IMAGE, fginst->image_width, fginst->image_height, (VOIDP)currInst->buffer[i].image, FALSE));
+        image[0].free = FALSE;
+        currInst->delivered = i;
+        if(statistics)
+            CountFrame(fginst, currInst->buffer[i].image);
+        return H_MSG_OK;
+    }
+
+    HReadSysComInfo(proc_id, HGInitNewImage, &save);
+    HWriteSysComInfo(proc_id, HGInitNewImage, FALSE);
+    *num_image = count;
+    for(ch = 0; ch < count && err == H_MSG_OK; ch++)
+        err = HNewImage(proc_id, &image[ch], fginst->bits_per_channel > 8 ? UINT2_IMAGE : BYTE_IMAGE,
+                        fginst->image_width / factor, fginst->image_height / factor);
+    HWriteSysComInfo(proc_id, HGInitNewImage, save);
+
+    for(ch = 0; ch < count && err == H_MSG_OK; ch++)
+        err = ConvertBuffer(fginst, index[ch], factor, statistics && ch == count - 1, &image[ch]);
+
+    return err;
+}
+
+/* Return grabbed buffers to the ring, except one held by a volatile
+ * image, and record their frames as delivered if the grab succeeded.    */
+static void ReleaseBuffers(TFGInstance * currInst, INT * index, INT count, HBOOL delivered)
+{
+    INT ch;
+
+    if(delivered)
+        for(ch = 0; ch < count; ch++)
+            FrameDelivered(currInst, index[ch]);
+
+    for(ch = 0; ch < count; ch++)
+        if(index[ch] != currInst->delivered)
+            ATOMIC_STORE(currInst->buffer[index[ch]].state, BUFFER_FREE);
+}
+
+static void ControlExposure(TFGInstance * currInst);
+
+/* Deliver grabbed frames as a data tuple: the full resolution image,
+ * followed by the reduced image if binning is set.                      */
+static Herror DeliverData(Hproc_handle proc_id, FGInstance * fginst, INT * index, Himage ** image, INT ** num_channel, INT * num_image,
+                          Hrlregion *** region, INT * num_region, Hcont *** cont, INT * num_cont, Hcpar ** data, INT * num_data)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT count = GrabFrames(currInst);
+    Herror err;
+
+    *num_image = 1;
+    err = DeliverBuffer(proc_id, fginst, index, count, 1, currInst->statistics || currInst->host_exposure, currInst->data_image, &currInst->data_channels[0]);
+    if(err == H_MSG_OK && currInst->binning > 1)
+    {
+        *num_image = 2;
+        err = DeliverBuffer(proc_id, fginst, index, count, currInst->binning, FALSE, currInst->data_image + currInst->data_channels[0],
+                            &currInst->data_channels[1]);
+    }
+    ReleaseBuffers(currInst, index, count, err == H_MSG_OK);
+    if(err == H_MSG_OK)
+        ControlExposure(currInst);
+
+    *image = currInst->data_image;
+    *num_channel = currInst->data_channels;
+    *region = NULL;
+    *num_region = 0;
+    *cont = NULL;
+    *num_cont = 0;
+    *data = NULL;
+    *num_data = 0;
+
+    return err;
+}
+
+/* Camera library calls, served by the playback device for instances
+ * opened on a recording.                                                 */
+static INT CameraStart(TFGInstance * currInst)
+{
+    if(currInst->player.data)
+        return PlaybackStart(&currInst->player);
+    return NETUSBCAM_Start(currInst->index);
+}
+
+static INT CameraStop(TFGInstance * currInst)
+{
+    if(currInst->player.data)
+        return PlaybackStop(&currInst->player);
+    return NETUSBCAM_Stop(currInst->index);
+}
+
+static INT CameraClose(TFGInstance * currInst)
+{
+    if(currInst->player.data)
+    {
+        PlaybackClose(&currInst->player);
+        return 0;
+    }
+    return NETUSBCAM_Close(currInst->index);
+}
+
+static INT CameraSetTrigger(TFGInstance * currInst, INT mode)
+{
+    if(currInst->player.data)
+        return PlaybackSetTrigger(&currInst->player, mode);
+    return NETUSBCAM_SetTrigger(currInst->index, mode);
+}
+
+static INT CameraGetModeList(TFGInstance * currInst, UINT * nmodes, UINT * modes)
+{
+    /* a recording has no modes to choose from */
+    if(currInst->player.data)
+    {
+        *nmodes = 0;
+        return 0;
+    }
+    return NETUSBCAM_GetModeList(currInst->index, nmodes, modes);
+}
+
+static INT CameraGetResolution(TFGInstance * currInst, INT * width, INT * height, INT * col, INT * row)
+{
+    INT bits;
+
+    if(currInst->player.data)
+    {
+        PlaybackGetFormat(&currInst->player, width, height, col, row, &bits);
+        return 0;
+    }
+    return NETUSBCAM_GetResolution(currInst->index, width, height, col, row);
+}
+
+static INT CameraGetResolutionRange(TFGInstance * currInst, ROI_RANGE_PROPERTY * range)
+{
+    INT width, height, col, row;
+
+    if(currInst->player.data)
+    {
+        CameraGetResolution(currInst, &width, &height, &col, &row);
+        range->nXMin = col;
+        range->nYMin = row;
+        range->nXMax = col + width;
+        range->nYMax = row + height;
+        return 0;
+    }
+    return NETUSBCAM_GetResolutionRange(currInst->index, range);
+}
+
+static INT CameraSetResolution(TFGInstance * currInst, INT width, INT height, INT col, INT row)
+{
+    INT w, h, c, r;
+
+    /* a recording can only be played back whole */
+    if(currInst->player.data)
+    {
+        CameraGetResolution(currInst, &w, &h, &c, &r);
+        return width == w && height == h && col == c && row == r ? 0 : 1;
+    }
+    return NETUSBCAM_SetResolution(currInst->index, width, height, col, row);
+}
+
+static INT AllocateImage(FGInstance * fginst)
 {
     TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
-    HBOOL ok;
     INT i;
-    UINT nmodes = NUM_MODES;
-    UINT modes[NUM_MODES];
-    PARAM_PROPERTY param_property;
+    void * ptr;
+
+    CameraGetResolution(currInst, &fginst->image_width, &fginst->image_height, &fginst->start_col, &fginst->start_row);
+    /* frames of more than 8 bits take up to two bytes per pixel */
+    currInst->buffer_size = fginst->image_width * fginst->image_height * (fginst->bits_per_channel > 8 ? sizeof(UINT2) : sizeof(HBYTE));
+    currInst->delivered = -1;
+    if(RecorderFormat(&currInst->recorder, fginst->image_width, fginst->image_height, fginst->start_row, fginst->start_col,
+                      fginst->bits_per_channel, currInst->buffer_size) != 0)
+        return 1;
+
+    /* buffers are only reallocated when the frame grows */
+    for(i = 0; i < currInst->buffer_count; i++)
+    {
+        if(currInst->buffer[i].size < currInst->buffer_size)
+        {
+            ptr = realloc(currInst->buffer[i].image, currInst->buffer_size);
+            if(!ptr)
+                return 1;
+            currInst->buffer[i].image = (HBYTE *)ptr;
+            currInst->buffer[i].size = currInst->buffer_size;
+        }
+        currInst->buffer[i].state = BUFFER_FREE;
+    }
+    for(; i < BUFFER_COUNT_MAX; i++)
+    {
+        free(currInst->buffer[i].image);
+        currInst->buffer[i].image = NULL;
+        currInst->buffer[i].size = 0;
+        currInst->buffer[i].state = BUFFER_FREE;
+    }
+
+    return 0;
+}
+
+/* Read the current ROI of an instance.                                  */
+static void GetRoi(FGInstance * fginst, INT * roi)
+{
+    roi[ROI_WIDTH] = fginst->image_width;
+    roi[ROI_HEIGHT] = fginst->image_height;
+    roi[ROI_ROW] = fginst->start_row;
+    roi[ROI_COL] = fginst->start_col;
+}
+
+/* Validate a whole ROI and apply it with a single camera restart.       */
+static Herror SetRoi(FGInstance * fginst, INT * roi)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
     ROI_RANGE_PROPERTY roi_range_property;
+    Herror err = H_MSG_OK;
 
-    if(!strcasecmp(param, FG_PARAM_HORIZONTAL_RESOLUTION))
+    if(roi[ROI_WIDTH] == fginst->image_width && roi[ROI_HEIGHT] == fginst->image_height
+       && roi[ROI_ROW] == fginst->start_row && roi[ROI_COL] == fginst->start_col)
+        return H_MSG_OK;
+    CameraGetResolutionRange(currInst, &roi_range_property);
+    if(roi[ROI_WIDTH] < 1 || roi[ROI_COL] < roi_range_property.nXMin || roi[ROI_COL] + roi[ROI_WIDTH] > roi_range_property.nXMax
+       || roi[ROI_HEIGHT] < 1 || roi[ROI_ROW] < roi_range_property.nYMin || roi[ROI_ROW] + roi[ROI_HEIGHT] > roi_range_property.nYMax)
+        return H_ERR_FGPARV;
+    if(CameraStop(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("stop camera failed")
+        return H_ERR_FGSETPAR;
+    }
+    if(CameraSetResolution(currInst, roi[ROI_WIDTH], roi[ROI_HEIGHT], roi[ROI_COL], roi[ROI_ROW]) != 0)
+        err = H_ERR_FGSETPAR;
+    if(AllocateImage(fginst) != 0)
+        err = H_ERR_MEM;
+    if(CameraStart(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("restart camera failed")
+        return H_ERR_FGSETPAR;
+    }
+
+    return err;
+}
+
+/* Resize the buffer ring, restarting the camera around it.              */
+static Herror SetBufferCount(FGInstance * fginst, INT count)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+
+    if(count == currInst->buffer_count)
+        return H_MSG_OK;
+    if(CameraStop(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("stop camera failed")
+        return H_ERR_FGSETPAR;
+    }
+    currInst->buffer_count = count;
+    if(AllocateImage(fginst) != 0)
+        return H_ERR_MEM;
+    if(CameraStart(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("restart camera failed")
+        return H_ERR_FGSETPAR;
+    }
+
+    return H_MSG_OK;
+}
+
+/* Find the register behind a parameter name (-1 if none), and which of
+ * its parameters the name refers to.                                     */
+static INT FindRegisterParam(char * param, INT * kind)
+{
+    INT r;
+
+    for(r = 0; r < NUM_REGISTERS; r++)
+    {
+        *kind = REGISTER_VALUE;
+        if(!strcasecmp(param, register_params[r].name))
+            return r;
+        *kind = REGISTER_RANGE;
+        if(!strcasecmp(param, register_params[r].range))
+            return r;
+        *kind = REGISTER_DESCR;
+        if(!strcasecmp(param, register_params[r].descr))
+            return r;
+        if(!register_params[r].auto_name)
+            continue;
+        *kind = REGISTER_AUTO;
+        if(!strcasecmp(param, register_params[r].auto_name))
+            return r;
+        *kind = REGISTER_AUTO_VALUES;
+        if(!strcasecmp(param, register_params[r].auto_values))
+            return r;
+        *kind = REGISTER_AUTO_DESCR;
+        if(!strcasecmp(param, register_params[r].auto_descr))
+            return r;
+    }
+
+    return -1;
+}
+
+/* Read the values, automatic flags and ranges of all camera registers
+ * into the cache, so that parameter access does not touch the device.   */
+static void LoadRegisters(TFGInstance * currInst)
+{
+    TFGRegister * reg;
+    INT r;
+
+    for(r = 0; r < NUM_REGISTERS; r++)
+    {
+        reg = &currInst->reg[r];
+        /* a recording has no registers */
+        if(currInst->player.data)
+        {
+            reg->valid = reg->auto_valid = FALSE;
+            reg->automatic = 0;
+            continue;
+        }
+        reg->valid = NETUSBCAM_GetCamParameterRange(currInst->index, register_params[r].reg, &reg->range) == 0
+                     && NETUSBCAM_GetCamParameter(currInst->index, register_params[r].reg, &reg->value) == 0;
+        reg->auto_valid = register_params[r].auto_name
+                          && NETUSBCAM_GetParamAuto(currInst->index, register_params[r].reg, &reg->automatic) == 0;
+        if(!reg->auto_valid)
+            reg->automatic = 0;
+    }
+}
+
+/* Write a register parameter through the cache to the camera.           */
+static Herror SetRegister(TFGInstance * currInst, INT r, INT kind, Hcpar * value)
+{
+    TFGRegister * reg = &currInst->reg[r];
+
+    if(kind == REGISTER_VALUE)
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(!reg->valid || reg->automatic)
+            return H_ERR_FGPARNA;
+        if(value->par.l < reg->range.nMin || value->par.l > reg->range.nMax)
+            return H_ERR_FGPARV;
+        if(NETUSBCAM_SetCamParameter(currInst->index, register_params[r].reg, (unsigned long)value->par.l) != 0)
+            return H_ERR_FGSETPAR;
+        reg->value = (unsigned long)value->par.l;
+        /* the pixel clock changes the ranges of the timing registers */
+        if(register_params[r].reg == REG_PLL)
+            LoadRegisters(currInst);
+    }
+    else if(kind == REGISTER_AUTO)
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!reg->auto_valid)
+            return H_ERR_FGPARNA;
+        if(strcasecmp(value->par.s, "true") && strcasecmp(value->par.s, "false"))
+            return H_ERR_FGPARV;
+        if(NETUSBCAM_SetParamAuto(currInst->index, register_params[r].reg, !strcasecmp(value->par.s, "true")) != 0)
+            return H_ERR_FGSETPAR;
+        reg->automatic = !strcasecmp(value->par.s, "true");
+        /* keep the value the automatic mode settled on */
+        if(!reg->automatic)
+            NETUSBCAM_GetCamParameter(currInst->index, register_params[r].reg, &reg->value);
+    }
+    else
+        return H_ERR_FGPARAM;
+
+    return H_MSG_OK;
+}
+
+/* Read a register parameter from the cache. Only values under automatic
+ * control are read from the camera, since it changes them itself.       */
+static Herror GetRegister(TFGInstance * currInst, INT r, INT kind, Hcpar * value, INT * num)
+{
+    TFGRegister * reg = &currInst->reg[r];
+    INT i;
+
+    switch(kind)
+    {
+        case REGISTER_VALUE:
+            if(!reg->valid)
+                return H_ERR_FGPARNA;
+            if(reg->automatic && NETUSBCAM_GetCamParameter(currInst->index, register_params[r].reg, &reg->value) != 0)
+                return H_ERR_FGGETPAR;
+            value->type = LONG_PAR;
+            value->par.l = reg->value;
+            break;
+        case REGISTER_RANGE:
+            if(!reg->valid)
+                return H_ERR_FGPARNA;
+            for(i = 0; i < 4; i++)
+                value[i].type = LONG_PAR;
+            value[0].par.l = reg->range.nMin;
+            value[1].par.l = reg->range.nMax;
+            value[2].par.l = 1;
+            value[3].par.l = reg->range.nDef;
+            *num = 4;
+            break;
+        case REGISTER_DESCR:
+            value->type = STRING_PAR;
+            value->par.s = register_params[r].descr_text;
+            break;
+        case REGISTER_AUTO:
+            if(!reg->auto_valid)
+                return H_ERR_FGPARNA;
+            value->type = STRING_PAR;
+            value->par.s = reg->automatic ? "true" : "false";
+            break;
+        case REGISTER_AUTO_VALUES:
+            value[0].par.s = "false";
+            value[0].type = STRING_PAR;
+            value[1].par.s = "true";
+            value[1].type = STRING_PAR;
+            *num = 2;
+            break;
+        case REGISTER_AUTO_DESCR:
+            value->type = STRING_PAR;
+            value->par.s = register_params[r].auto_descr_text;
+            break;
+    }
+
+    return H_MSG_OK;
+}
+
+/* Index of the register parameter of a camera register, or -1.         */
+static INT FindRegister(INT reg)
+{
+    INT r;
+
+    for(r = 0; r < NUM_REGISTERS; r++)
+        if(register_params[r].reg == reg)
+            return r;
+
+    return -1;
+}
+
+/* Scale register r by ratio, but not below low, and return the ratio
+ * actually applied.                                                      */
+static double ScaleRegister(TFGInstance * currInst, INT r, double ratio, long low)
+{
+    TFGRegister * reg = &currInst->reg[r];
+    double base = reg->value ? (double)reg->value : 1.0;
+    double target = base * ratio;
+    Hcpar value;
+
+    if(target < low)
+        target = low;
+    if(target < reg->range.nMin)
+        target = reg->range.nMin;
+    if(target > reg->range.nMax)
+        target = reg->range.nMax;
+    value.type = LONG_PAR;
+    value.par.l = (long)(target + 0.5);
+    if(value.par.l == (long)reg->value || SetRegister(currInst, r, REGISTER_VALUE, &value) != H_MSG_OK)
+        return 1.0;
+
+    return value.par.l / base;
+}
+
+/* Steer exposure time and gain towards the target mean brightness from
+ * the statistics of the last frame delivered. Frames exposed before the
+ * last change, plus the frames to settle, are not measured. The
+ * exposure time is raised before the gain and the gain lowered before
+ * the exposure time, down to its default, to keep the noise down.       */
+static void ControlExposure(TFGInstance * currInst)
+{
+    INT exposure = FindRegister(REG_EXPOSURE_TIME), gain = FindRegister(REG_GAIN), lowest, highest;
+    double mean, ratio, step = currInst->exposure_step;
+    UINT saturated;
+
+    if(!currInst->host_exposure || !SEQ_BEFORE(currInst->exposure_seq, currInst->stats.last_seq))
+        return;
+    if(!SummarizeStatistics(&currInst->pixel_stats, &mean, &lowest, &highest, &saturated))
+        return;
+
+    /* the target is on the 8-bit scale */
+    mean /= 1 << (currInst->pixel_stats.depth - 8);
+    if(saturated > EXPOSURE_SATURATED * currInst->pixel_stats.count)
+        ratio = 1.0 / step;
+    else if(mean < 1.0)
+        ratio = step;
+    else
+    {
+        ratio = currInst->exposure_target / mean;
+        if(ratio > step)
+            ratio = step;
+        if(ratio < 1.0 / step)
+            ratio = 1.0 / step;
+    }
+    if(ratio > 1.0 - EXPOSURE_TOLERANCE && ratio < 1.0 + EXPOSURE_TOLERANCE)
+        return;
+
+    if(gain >= 0 && !currInst->reg[gain].valid)
+        gain = -1;
+    if(ratio > 1.0)
+    {
+        ratio /= ScaleRegister(currInst, exposure, ratio, 0);
+        if(gain >= 0 && ratio > 1.0 + EXPOSURE_TOLERANCE)
+            ScaleRegister(currInst, gain, ratio, 0);
+    }
+    else
+    {
+        /* a gain already below its default is left for the exposure */
+        if(gain >= 0 && currInst->reg[gain].value > (unsigned long)currInst->reg[gain].range.nDef)
+            ratio /= ScaleRegister(currInst, gain, ratio, currInst->reg[gain].range.nDef);
+        if(ratio < 1.0 - EXPOSURE_TOLERANCE)
+            ScaleRegister(currInst, exposure, ratio, 0);
+    }
+
+    currInst->exposure_seq = ATOMIC_LOAD(currInst->seq) + currInst->exposure_settle;
+}
+
+/* Open the camera at the port of an instance in the mode closest to its
+ * resolution.                                                            */
+static Herror OpenCamera(FGInstance * fginst)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT i;
+    UINT mode, nmodes = NUM_MODES;
+    UINT modes[NUM_MODES];
+
+    if(fginst->port >= num_devices)
+    {
+        MY_PRINT_ERROR_MESSAGE("invalid device index")
+        return H_ERR_FGNI;
+    }
+    for(i = 0; i < FG_MAX_INST; i++)
+    {
+        if(FGInst[i].open && FGInst[i].index == fginst->port)
+        {
+            MY_PRINT_ERROR_MESSAGE("camera already in use")
+            return H_ERR_FGDV;
+        }
+    }
+    currInst->index = fginst->port;
+    if(NETUSBCAM_Open(currInst->index) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("open camera failed")
+        return H_ERR_FGNI;
+    }
+
+    if(fginst->horizontal_resolution > 0 && fginst->vertical_resolution > 0)
+    {
+        NETUSBCAM_GetModeList(currInst->index, &nmodes, modes);
+        for(i = 0; i < nmodes; i++)
+        {
+            if(fginst->horizontal_resolution == modelist[modes[i]][0] && fginst->vertical_resolution == modelist[modes[i]][1])
+            {
+                NETUSBCAM_SetMode(currInst->index, modes[i]);
+                fginst->horizontal_resolution = modelist[modes[i]][0];
+                fginst->vertical_resolution = modelist[modes[i]][1];
+                break;
+            }
+        }
+    }
+    else
+    {
+        NETUSBCAM_GetMode(currInst->index, &mode);
+        fginst->horizontal_resolution = modelist[mode][0];
+        fginst->vertical_resolution = modelist[mode][1];
+    }
+    NETUSBCAM_SetCallback(currInst->index, CALLBACK_RAW, &ImageComplete, (void *)currInst);
+
+    return H_MSG_OK;
+}
+
+/* Open the recording named by the camera type of an instance for
+ * playback through the camera callback.                                  */
+static Herror OpenPlayback(FGInstance * fginst)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT col, row, bits;
+
+    if(PlaybackOpen(&currInst->player, fginst->camera_type) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("open recording failed")
+        return H_ERR_FGNI;
+    }
+    currInst->index = -1;
+    currInst->player.callback = &ImageComplete;
+    currInst->player.ready = &BufferReady;
+    currInst->player.context = (void *)currInst;
+    PlaybackGetFormat(&currInst->player, &fginst->horizontal_resolution, &fginst->vertical_resolution, &col, &row, &bits);
+    /* the raw frames fix the depth; more than 8 bits are only gray */
+    if(bits > 8 && !strcasecmp(fginst->color_space, "rgb"))
+    {
+        MY_PRINT_ERROR_MESSAGE("recording depth not available in rgb")
+        PlaybackClose(&currInst->player);
+        return H_ERR_FGPARV;
+    }
+    fginst->bits_per_channel = bits;
+
+    return H_MSG_OK;
+}
+
+static Herror FGOpen(Hproc_handle proc_id, FGInstance * fginst)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    Herror err;
+
+    /* any camera type but the default names a recording to play back */
+    if(fginst->camera_type[0] && strcasecmp(fginst->camera_type, "default"))
+        err = OpenPlayback(fginst);
+    else
+        err = OpenCamera(fginst);
+    if(err != H_MSG_OK)
+        return err;
+
+    if(fginst->image_width && fginst->image_height)
+    {
+        if(CameraSetResolution(currInst, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("setting ROI failed")
+        }
+    }
+
+    /* frames of more than 8 bits are delivered as uint2 gray images */
+    if((fginst->bits_per_channel != 10 && fginst->bits_per_channel != 12) || !strcasecmp(fginst->color_space, "rgb"))
+        fginst->bits_per_channel = 8;
+
+    if(AllocateImage(fginst) != 0)
+    {
+        FreeImage(currInst);
+        CameraClose(currInst);
+        return H_ERR_MEM;
+    }
+
+    LoadRegisters(currInst);
+
+    if(fginst->external_trigger)
+        CameraSetTrigger(currInst, TRIG_HW_START);
+    else
+    {
+        //NETUSBCAM_SetTrigger(currInst->index, TRIG_STOP);
+        //NETUSBCAM_SetTrigger(currInst->index, TRIG_SW_START);
+    }
+    currInst->trigger_mode = fginst->external_trigger ? TRIGGER_HARDWARE : TRIGGER_FREE_RUN;
+    currInst->trigger_seq = currInst->trigger_due = currInst->seq;
+
+    currInst->async_started = FALSE;
+    currInst->delivered = -1;
+    currInst->color = !strcasecmp(fginst->color_space, "rgb");
+    currInst->burst_length = 1;
+    currInst->binning = 1;
+    currInst->average_frames = 1;
+    currInst->correction = FALSE;
+    currInst->sync_group = 0;
+    currInst->sync_skew = 0.0;
+    ResetStatistics(&currInst->stats);
+    ClearStatistics(&currInst->pixel_stats, 8);
+
+    if(CameraStart(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("start camera failed")
+        FreeImage(currInst);
+        CameraClose(currInst);
+        return H_ERR_FGF;
+    }
+    currInst->open = TRUE;
+    num_instances++;
+
+    return H_MSG_OK;
+}
+
+static Herror CloseInstance(Hproc_handle proc_id, FGInstance * fginst)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+
+    if(CameraStop(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("stop camera failed")
+        return H_ERR_FGF;
+    }
+    if(RecorderStop(&currInst->recorder) != 0)
+        MY_PRINT_ERROR_MESSAGE("recording incomplete")
+
+    if(CameraClose(currInst) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("close camera failed")
+        return H_ERR_FGCLOSE;
+    }
+    currInst->open = FALSE;
+    num_instances--;
+
+    FreeImage(currInst);
+    CorrectionFree(&currInst->corr);
+
+    return H_MSG_OK;
+}
+
+static Herror FGClose(Hproc_handle proc_id, FGInstance * fginst)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    /* a running grab may read the buffers */
+    err = CloseInstance(proc_id, fginst);
+    GiveLock(lock);
+
+    return err;
+}
+
+/* Expose count frames with software triggers. start receives the
+ * sequence number after which their frames come: frames still due from
+ * earlier triggers, such as the late frame of a timed out grab, come
+ * first. An earlier trigger whose frame has not come within twice the
+ * grab timeout is taken as lost. Returns 0 on success.                   */
+static INT SoftwareTrigger(TFGInstance * currInst, INT count, UINT * start)
+{
+    INT i;
+
+    *start = ATOMIC_LOAD(currInst->seq);
+    if(SEQ_BEFORE(*start, currInst->trigger_due) && Now() - currInst->trigger_time < 2.0 * currInst->grab_timeout)
+        *start = currInst->trigger_due;
+    currInst->trigger_due = *start;
+    currInst->trigger_time = Now();
+    for(i = 0; i < count; i++)
+    {
+        if(CameraSetTrigger(currInst, TRIG_SW_DO) != 0)
+            return 1;
+        currInst->trigger_due++;
+    }
+
+    return 0;
+}
+
+static Herror StartAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+
+    /* a group grab triggers its members itself; the camera's own
+       asynchronous grabs start afresh once it leaves the group */
+    if(currInst->sync_group > 0)
+    {
+        currInst->async_seq = ATOMIC_LOAD(currInst->seq);
+        currInst->async_started = FALSE;
+        return H_MSG_OK;
+    }
+
+    /* the grab covers every frame captured from now on */
+    currInst->async_seq = ATOMIC_LOAD(currInst->seq);
+
+    /* in software trigger mode, starting a grab exposes its frames */
+    if(currInst->trigger_mode == TRIGGER_SOFTWARE && SoftwareTrigger(currInst, GrabFrames(currInst), &currInst->async_seq) != 0)
+    {
+        MY_PRINT_ERROR_MESSAGE("software trigger failed")
+        return H_ERR_FGF;
+    }
+    currInst->async_started = TRUE;
+
+    return H_MSG_OK;
+}
+
+/* Wait for the frames of the next grab and mark them as being grabbed.
+ * Asynchronous and software triggered grabs take the frames following
+ * the last grab or trigger, synchronous ones the frames chosen by the
+ * grab mode.                                                             */
+static Herror WaitGrab(Hproc_handle proc_id, FGInstance * fginst, HBOOL async, double maxDelay, INT * index)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT count = GrabFrames(currInst);
+    HBOOL found, after = FALSE;
+    UINT seq = 0;
+
+    if(!async)
+    {
+        /* a software triggered grab waits for the frames of its own trigger */
+        maxDelay = -1.0;
+        if(currInst->trigger_mode != TRIGGER_SOFTWARE)
+        {
+            currInst->async_started = FALSE;
+            if(currInst->grab_mode == GRAB_NEXT)
+            {
+                /* skip the frames queued or in transfer */
+                after = TRUE;
+                seq = ATOMIC_LOAD(currInst->seq);
+            }
+            else if(currInst->grab_mode == GRAB_NEWEST && NewestBuffer(currInst, &seq) >= 0)
+            {
+                /* skip all but the newest burst queued */
+                after = TRUE;
+                seq -= count;
+            }
+            return WaitBuffers(currInst, after, seq, maxDelay, count, index) ? H_MSG_OK : H_ERR_FGTIMEOUT;
+        }
+    }
+
+    if(!currInst->async_started)
+        HCkP(StartAsync(proc_id, fginst, maxDelay));
+
+    found = WaitBuffers(currInst, TRUE, currInst->async_seq, maxDelay, count, index);
+
+    if(currInst->trigger_mode == TRIGGER_SOFTWARE)
+    {
+        /* each trigger serves one grab; with trigger ahead, the next
+           exposure overlaps the delivery of this one (a failed trigger is
+           retried by the next grab) */
+        currInst->async_started = FALSE;
+        if(found && currInst->trigger_ahead)
+            StartAsync(proc_id, fginst, maxDelay);
+    }
+    else if(found)
+    {
+        /* the next asynchronous grab continues right after these frames */
+        currInst->async_seq = currInst->buffer[index[count - 1]].seq;
+    }
+
+    return found ? H_MSG_OK : H_ERR_FGTIMEOUT;
+}
+
+/* A camera taking part in a group grab                                   */
+typedef struct
+{
+    FGInstance * fginst;
+    TFGInstance * inst;
+    HBOOL after;
+    UINT seq;
+    UINT base;
+    INT index;
+    Himage * image;
+    Herror err;
+    HBOOL posted;
+} TGroupMember;
+
+/* Find the open instances of a synchronization group, in instance order. */
+static INT GroupMembers(INT group, TGroupMember * member)
+{
+    INT i, n = 0;
+
+    for(i = 0; i < FG_MAX_INST; i++)
+    {
+        if(FGInst[i].open && FGInst[i].sync_group == group && fgClass->instance[i])
+        {
+            member[n].fginst = fgClass->instance[i];
+            member[n].inst = &FGInst[i];
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/* Position of a taken frame on the time line shared by a group: its
+ * trigger number counted from base, or the time in milliseconds its
+ * callback ran on the host, as the SDK passes no camera timestamp.       */
+static double GroupKey(TGroupMember * m, INT match)
+{
+    TFGBuffer * buf = &m->inst->buffer[m->index];
+
+    if(match == SYNC_TIMESTAMP)
+        return buf->time;
+    return (double)(INT)(buf->seq - m->base);
+}
+
+/* Wait for one frame of each member, all with the same trigger number or
+ * arrived within the tolerance, and mark them as being grabbed. The
+ * oldest frames of the members are compared; one older than the newest
+ * of them beyond the tolerance cannot be matched any more, since the
+ * other members only deliver newer frames, and is dropped. Returns FALSE
+ * on timeout.                                                            */
+static HBOOL WaitGroup(TFGInstance * currInst, TGroupMember * member, INT n, double maxDelay)
+{
+    double timeout = Now() + currInst->grab_timeout, tolerance, newest, key;
+    UINT done[FG_MAX_INST];
+    HBOOL lost;
+    INT k, empty;
+
+    tolerance = currInst->sync_match == SYNC_TIMESTAMP ? currInst->sync_tolerance : 0.0;
+    for(k = 0; k < n; k++)
+        member[k].index = -1;
+
+    for(;;)
+    {
+        for(k = 0; k < n; k++)
+            done[k] = __atomic_load_n(&member[k].inst->done, __ATOMIC_SEQ_CST);
+        for(empty = 0; empty < n; empty++)
+            if((member[empty].index = TakeOldest(member[empty].inst, member[empty].after, member[empty].seq, maxDelay)) < 0)
+                break;
+        if(empty == n)
+        {
+            newest = GroupKey(&member[0], currInst->sync_match);
+            for(k = 1; k < n; k++)
+                if((key = GroupKey(&member[k], currInst->sync_match)) > newest)
+                    newest = key;
+            lost = FALSE;
+            for(k = 0; k < n; k++)
+            {
+                if(GroupKey(&member[k], currInst->sync_match) < newest - tolerance)
+                {
+                    ATOMIC_STORE(member[k].inst->buffer[member[k].index].state, BUFFER_FREE);
+                    ATOMIC_INC(member[k].inst->stats.dropped);
+                    member[k].index = -1;
+                    lost = TRUE;
+                }
+            }
+            if(!lost)
+                return TRUE;
+        }
+
+        /* the frames kept are compared again with the next ones */
+        for(k = 0; k < n; k++)
+        {
+            if(member[k].index >= 0)
+                ATOMIC_STORE(member[k].inst->buffer[member[k].index].state, BUFFER_FILLED);
+            member[k].index = -1;
+        }
+        if(empty == n)
+            continue;
+        if(Now() >= timeout)
+            break;
+        WaitFrame(member[empty].inst, done[empty], timeout - Now());
+    }
+    currInst->stats.timeouts++;
+
+    return FALSE;
+}
+
+static void * ConvertThread(void * arg)
+{
+    TGroupMember * m = (TGroupMember *)arg;
+
+    m->err = ConvertBuffer(m->fginst, m->index, m->inst->binning, m->inst->statistics || m->inst->host_exposure, m->image);
+
+    return NULL;
+}
+
+/* Conversion thread of an instance for group grabs, kept until its
+ * buffers are freed: converts the posted member each time work_posted
+ * advances, then sets work_done to it.                                   */
+static void * GroupWorker(void * arg)
+{
+    TFGInstance * currInst = (TFGInstance *)arg;
+    UINT posted, seen = ATOMIC_LOAD(currInst->work_done);
+
+    for(;;)
+    {
+        posted = ATOMIC_LOAD(currInst->work_posted);
+        if(posted == seen)
+        {
+            syscall(SYS_futex, &currInst->work_posted, FUTEX_WAIT_PRIVATE, posted, NULL, NULL, 0);
+            continue;
+        }
+        if(!ATOMIC_LOAD(currInst->worker_running))
+            break;
+        ConvertThread(currInst->work);
+        seen = posted;
+        ATOMIC_STORE(currInst->work_done, posted);
+        syscall(SYS_futex, &currInst->work_done, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    return NULL;
+}
+
+/* Hand the conversion of a member's frame to its thread, starting the
+ * thread on first use. Returns FALSE if there is none.                   */
+static HBOOL PostConversion(TGroupMember * m)
+{
+    TFGInstance * inst = m->inst;
+
+    if(!inst->worker_running)
+    {
+        ATOMIC_STORE(inst->worker_running, TRUE);
+        if(pthread_create(&inst->worker, NULL, GroupWorker, inst) != 0)
+        {
+            ATOMIC_STORE(inst->worker_running, FALSE);
+            return FALSE;
+        }
+    }
+    inst->work = m;
+    ATOMIC_STORE(inst->work_posted, inst->work_posted + 1);
+    syscall(SYS_futex, &inst->work_posted, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+
+    return TRUE;
+}
+
+/* Wait until the thread of an instance finished the conversion posted.  */
+static void WaitConversion(TFGInstance * inst)
+{
+    UINT done;
+
+    while((done = ATOMIC_LOAD(inst->work_done)) != inst->work_posted)
+        syscall(SYS_futex, &inst->work_done, FUTEX_WAIT_PRIVATE, done, NULL, NULL, 0);
+}
+
+/* Grab one frame from each camera of the group of an instance, as the
+ * channels of one image in instance order. The frames are matched as set
+ * by sync_match, and converted by one thread per camera. Members in
+ * software trigger mode are triggered by the grab.                       */
+static Herror GrabGroup(Hproc_handle proc_id, FGInstance * fginst, double maxDelay, Himage * image, INT * num_image)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    TGroupMember member[FG_MAX_INST];
+    Herror err = H_MSG_OK;
+    INT n, k, save, width, height, bits;
+    TFGBuffer * buf;
+    double first, last;
+    UINT seq;
+
+    n = GroupMembers(currInst->sync_group, member);
+    width = fginst->image_width / currInst->binning;
+    height = fginst->image_height / currInst->binning;
+    bits = fginst->bits_per_channel;
+    for(k = 0; k < n; k++)
+    {
+        if(member[k].fginst->image_width / member[k].inst->binning != width
+           || member[k].fginst->image_height / member[k].inst->binning != height || member[k].fginst->bits_per_channel != bits)
+        {
+            MY_PRINT_ERROR_MESSAGE("group images differ in size or pixel type")
+            return H_ERR_FGF;
+        }
+    }
+
+    /* frames are taken as by the grab mode of this instance, and only
+       after the trigger count started when matched by trigger; the
+       trigger of a software triggered member is the grab's own */
+    for(k = 0; k < n; k++)
+        ReleaseDelivered(member[k].inst);
+    for(k = 0; k < n; k++)
+    {
+        member[k].after = FALSE;
+        member[k].seq = 0;
+        member[k].base = member[k].inst->trigger_seq;
+        if(member[k].inst->trigger_mode == TRIGGER_SOFTWARE)
+        {
+            /* a trigger left over from a failed grab is skipped */
+            member[k].after = TRUE;
+            if(SoftwareTrigger(member[k].inst, 1, &member[k].seq) != 0)
+            {
+                MY_PRINT_ERROR_MESSAGE("software trigger failed")
+                return H_ERR_FGF;
+            }
+            member[k].base = member[k].seq;
+        }
+        else if(currInst->grab_mode == GRAB_NEXT)
+        {
+            member[k].after = TRUE;
+            member[k].seq = ATOMIC_LOAD(member[k].inst->seq);
+        }
+        else if(currInst->grab_mode == GRAB_NEWEST && NewestBuffer(member[k].inst, &seq) >= 0)
+        {
+            member[k].after = TRUE;
+            member[k].seq = seq - 1;
+        }
+        if(currInst->sync_match == SYNC_TRIGGER && (!member[k].after || SEQ_BEFORE(member[k].seq, member[k].base)))
+        {
+            member[k].after = TRUE;
+            member[k].seq = member[k].base;
+        }
+    }
+    if(!WaitGroup(currInst, member, n, maxDelay))
+        return H_ERR_FGTIMEOUT;
+
+    HReadSysComInfo(proc_id, HGInitNewImage, &save);
+    HWriteSysComInfo(proc_id, HGInitNewImage, FALSE);
+    *num_image = n;
+    for(k = 0; k < n && err == H_MSG_OK; k++)
+    {
+        member[k].image = &image[k];
+        err = HNewImage(proc_id, &image[k], bits > 8 ? UINT2_IMAGE : BYTE_IMAGE, width, height);
+    }
+    HWriteSysComInfo(proc_id, HGInitNewImage, save);
+
+    if(err == H_MSG_OK)
+    {
+        /* the calling thread converts the first frame */
+        for(k = 1; k < n; k++)
+            member[k].posted = PostConversion(&member[k]);
+        ConvertThread(&member[0]);
+        for(k = 1; k < n; k++)
+        {
+            if(member[k].posted)
+                WaitConversion(member[k].inst);
+            else
+                ConvertThread(&member[k]);
+        }
+        for(k = 0; k < n; k++)
+            if(member[k].err != H_MSG_OK)
+                err = member[k].err;
+    }
+
+    first = last = member[0].inst->buffer[member[0].index].time;
+    for(k = 0; k < n; k++)
+    {
+        buf = &member[k].inst->buffer[member[k].index];
+        first = buf->time < first ? buf->time : first;
+        last = buf->time > last ? buf->time : last;
+        ReleaseBuffers(member[k].inst, &member[k].index, 1, err == H_MSG_OK);
+        if(err == H_MSG_OK)
+            ControlExposure(member[k].inst);
+    }
+    currInst->sync_skew = last - first;
+
+    return err;
+}
+
+static Herror GrabImage(Hproc_handle proc_id, FGInstance * fginst, HBOOL async, double maxDelay, Himage * image, INT * num_image)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT index[BURST_LENGTH_MAX];
+    Herror err;
+
+    if(currInst->sync_group > 0)
+        return GrabGroup(proc_id, fginst, maxDelay, image, num_image);
+    HCkP(WaitGrab(proc_id, fginst, async, maxDelay, index));
+    err = DeliverBuffer(proc_id, fginst, index, GrabFrames(currInst), currInst->binning, currInst->statistics || currInst->host_exposure, image, num_image);
+    ReleaseBuffers(currInst, index, GrabFrames(currInst), err == H_MSG_OK);
+    if(err == H_MSG_OK)
+        ControlExposure(currInst);
+
+    return err;
+}
+
+static Herror GrabData(Hproc_handle proc_id, FGInstance * fginst, HBOOL async, double maxDelay, Himage ** image, INT ** num_channel, INT * num_image,
+                       Hrlregion *** region, INT * num_region, Hcont *** cont, INT * num_cont, Hcpar ** data, INT * num_data)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT index[BURST_LENGTH_MAX];
+
+    /* a group is only grabbed as images */
+    if(currInst->sync_group > 0)
+        return H_ERR_FGPARNA;
+    HCkP(WaitGrab(proc_id, fginst, async, maxDelay, index));
+
+    return DeliverData(proc_id, fginst, index, image, num_channel, num_image, region, num_region, cont, num_cont, data, num_data);
+}
+
+/* The grab entry points take the consumer lock of the instance, so that
+ * one grab of a camera or group at a time takes its frames.             */
+static Herror FGGrabStartAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    err = StartAsync(proc_id, fginst, maxDelay);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGGrabAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay, Himage * image, INT * num_image)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    err = GrabImage(proc_id, fginst, TRUE, maxDelay, image, num_image);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGGrab(Hproc_handle proc_id, FGInstance * fginst, Himage * image, INT * num_image)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    err = GrabImage(proc_id, fginst, FALSE, -1.0, image, num_image);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGGrabDataAsync(Hproc_handle proc_id, FGInstance * fginst, double maxDelay, Himage ** image, INT ** num_channel, INT * num_image,
+                              Hrlregion *** region, INT * num_region, Hcont *** cont, INT * num_cont, Hcpar ** data, INT * num_data)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    err = GrabData(proc_id, fginst, TRUE, maxDelay, image, num_channel, num_image, region, num_region, cont, num_cont, data, num_data);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGGrabData(Hproc_handle proc_id, FGInstance * fginst, Himage ** image, INT ** num_channel, INT * num_image,
+                         Hrlregion *** region, INT * num_region, Hcont *** cont, INT * num_cont, Hcpar ** data, INT * num_data)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    err = GrabData(proc_id, fginst, FALSE, -1.0, image, num_channel, num_image, region, num_region, cont, num_cont, data, num_data);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGInfo(Hproc_handle proc_id, INT queryType, char ** info, Hcpar ** values, INT * numValues)
+{
+    Hcpar *val;
+    INT i;
+
+    switch(queryType)
+    {
+        case FG_QUERY_GENERAL:
+            *info = "HALCON image acquisition interface for NET iCube.";
+            *values = NULL;
+            *numValues = 0;
+            break;
+        case FG_QUERY_DEFAULTS:
+            *info = "Default values (as used for open_framegrabber).";
+            HCkP(HFgGetDefaults(proc_id, fgClass, values, numValues));
+            break;
+        case FG_QUERY_PARAMETERS:
+            *info = "Additional parameters for this image acquisition interface.";
+            HCkP(HAlloc(proc_id, (size_t)(NUM_PARAMS * sizeof(Hcpar)), &val));
+            for(i = 0; i < NUM_PARAMS; i++)
+            {
+                val[i].par.s = params[i];
+                val[i].type = STRING_PAR;
+            }
+            *values = val;
+            *numValues = NUM_PARAMS;
+            break;
+        case FG_QUERY_PARAMETERS_RO:
+            *info = "Additional read-only parameters for this interface.";
+            HCkP(HAlloc(proc_id, (size_t)(NUM_PARAMS_RO * sizeof(Hcpar)), &val));
+            for(i = 0; i < NUM_PARAMS_RO; i++)
+            {
+                val[i].par.s = params_ro[i];
+                val[i].type = STRING_PAR;
+            }
+            *values = val;
+            *numValues = NUM_PARAMS_RO;
+            break;
+        case FG_QUERY_PARAMETERS_WO:
+            *info = "Additional write-only parameters for this interface.";
+            HCkP(HAlloc(proc_id, (size_t)(NUM_PARAMS_WO * sizeof(Hcpar)), &val));
+            for(i = 0; i < NUM_PARAMS_WO; i++)
+            {
+                val[i].par.s = params_wo[i];
+                val[i].type = STRING_PAR;
+            }
+            *values = val;
+            *numValues = NUM_PARAMS_WO;
+            break;
+        case FG_QUERY_REVISION:
+            *info = "Current interface revision.";
+            HCkP(HAlloc(proc_id, (size_t)(sizeof(Hcpar)), &val));
+            val[0].par.s = INTERFACE_REVISION;
+            val[0].type = STRING_PAR;
+            *values = val;
+            *numValues = 1;
+            break;
+        case FG_QUERY_CAMERA_TYPE:
+            *info = "'default' for the camera at the port, or the file name of a recording to play back.";
+            *values = NULL;
+            *numValues = 0;
+            break;
+        case FG_QUERY_PORT:
+            *info = "List of available camera device indices.";
+            HCkP(HAlloc(proc_id, (size_t)(num_devices * sizeof(Hcpar)), &val));
+            for(i = 0; i < num_devices; i++)
+            {
+                val[i].par.l = i;
+                val[i].type = LONG_PAR;
+            }
+            *values = val;
+            *numValues = num_devices;
+            break;
+        case FG_QUERY_EXT_TRIGGER:
+            *info = "Value list for ExternalTrigger parameter.";
+            HCkP(HAlloc(proc_id, (size_t)(2 * sizeof(*val)), &val));
+            val[0].par.s = "false";
+            val[0].type = STRING_PAR;
+            val[1].par.s = "true";
+            val[1].type = STRING_PAR;
+            *values = val;
+            *numValues = 2;
+            break;
+        case FG_QUERY_HORIZONTAL_RESOLUTION:
+            *info = "Supported HorizontalResolution values.";
+            HCkP(HAlloc(proc_id, (size_t)(NUM_MODES * sizeof(*val)), &val));
+            for(i = 0; i < NUM_MODES; i++)
+            {
+                val[i].par.l = modelist[i][0];
+                val[i].type = LONG_PAR;
+            }
+            *values = val;
+            *numValues = NUM_MODES;
+            break;
+        case FG_QUERY_VERTICAL_RESOLUTION:
+            *info = "Supported VerticalResolution values.";
+            HCkP(HAlloc(proc_id, (size_t)(NUM_MODES * sizeof(*val)), &val));
+            for(i = 0; i < NUM_MODES; i++)
+            {
+                val[i].par.l = modelist[i][1];
+                val[i].type = LONG_PAR;
+            }
+            *values = val;
+            *numValues = NUM_MODES;
+            break;
+        case FG_QUERY_COLOR_SPACE:
+            *info = "Value list for ColorSpace parameter.";
+            HCkP(HAlloc(proc_id, (size_t)(3 * sizeof(*val)), &val));
+            val[0].par.s = "default";
+            val[0].type = STRING_PAR;
+            val[1].par.s = "gray";
+            val[1].type = STRING_PAR;
+            val[2].par.s = "rgb";
+            val[2].type = STRING_PAR;
+            *values = val;
+            *numValues = 3;
+            break;
+        case FG_QUERY_BITS_PER_CHANNEL:
+            *info = "Value list for BitsPerChannel parameter.";
+            HCkP(HAlloc(proc_id, (size_t)(3 * sizeof(*val)), &val));
+            for(i = 0; i < 3; i++)
+            {
+                val[i].par.l = 8 + 2 * i;
+                val[i].type = LONG_PAR;
+            }
+            *values = val;
+            *numValues = 3;
+            break;
+        case FG_QUERY_INFO_BOARDS:
+        case FG_QUERY_DEVICE:
+        case FG_QUERY_FIELD:
+        case FG_QUERY_GENERIC:
+            *info = "Unused.";
+            *values = NULL;
+            *numValues = 0;
+            break;
+        default:
+            *info = "Unsupported query!";
+            *values = NULL;
+            *numValues = 0;
+    }
+
+    return H_MSG_OK;
+}
+
+static Herror SetParam(Hproc_handle proc_id, FGInstance * fginst, char * param, Hcpar * value, INT num)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    HBOOL ok;
+    Hcpar auto_off;
+    double f;
+    INT i, r, kind, roi[4];
+    UINT nmodes = NUM_MODES;
+    UINT modes[NUM_MODES];
+
+    if(!strcasecmp(param, FG_PARAM_HORIZONTAL_RESOLUTION))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l == fginst->horizontal_resolution)
+            return H_MSG_OK;
+        if(CameraStop(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("stop camera failed")
+            return H_ERR_FGSETPAR;
+        }
+        ok = FALSE;
+        CameraGetModeList(currInst, &nmodes, modes);
+        for(i = 0; i < nmodes; i++)
+        {
+            if(value->par.l == modelist[modes[i]][0])
+            {
+                NETUSBCAM_SetMode(currInst->index, modes[i]);
+                fginst->horizontal_resolution = modelist[modes[i]][0];
+                fginst->vertical_resolution = modelist[modes[i]][1];
+                ok = TRUE;
+                break;
+            }
+        }
+        if(!ok)
+        {
+            /* keep the camera running in the mode it had */
+            CameraStart(currInst);
+            return H_ERR_FGPARV;
+        }
+        if(AllocateImage(fginst) != 0)
+            return H_ERR_MEM;
+        LoadRegisters(currInst);
+        if(CameraStart(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("restart camera failed")
+            return H_ERR_FGSETPAR;
+        }
+    }
+    else if(!strcasecmp(param, FG_PARAM_VERTICAL_RESOLUTION))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l == fginst->vertical_resolution)
+            return H_MSG_OK;
+        if(CameraStop(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("stop camera failed")
+            return H_ERR_FGSETPAR;
+        }
+        ok = FALSE;
+        CameraGetModeList(currInst, &nmodes, modes);
+        for(i = 0; i < nmodes; i++)
+        {
+            if(value->par.l == modelist[modes[i]][1])
+            {
+                NETUSBCAM_SetMode(currInst->index, modes[i]);
+                fginst->horizontal_resolution = modelist[modes[i]][0];
+                fginst->vertical_resolution = modelist[modes[i]][1];
+                ok = TRUE;
+                break;
+            }
+        }
+        if(!ok)
+        {
+            /* keep the camera running in the mode it had */
+            CameraStart(currInst);
+            return H_ERR_FGPARV;
+        }
+        if(AllocateImage(fginst) != 0)
+            return H_ERR_MEM;
+        LoadRegisters(currInst);
+        if(CameraStart(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("restart camera failed")
+            return H_ERR_FGSETPAR;
+        }
+    }
+    else if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH) || !strcasecmp(param, FG_PARAM_IMAGE_HEIGHT)
+            || !strcasecmp(param, FG_PARAM_START_ROW) || !strcasecmp(param, FG_PARAM_START_COL))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        /* in deferred mode, only stage the value until apply_roi */
+        if(!currInst->roi_deferred)
+            GetRoi(fginst, currInst->roi);
+        if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH))
+            currInst->roi[ROI_WIDTH] = value->par.l;
+        else if(!strcasecmp(param, FG_PARAM_IMAGE_HEIGHT))
+            currInst->roi[ROI_HEIGHT] = value->par.l;
+        else if(!strcasecmp(param, FG_PARAM_START_ROW))
+            currInst->roi[ROI_ROW] = value->par.l;
+        else
+            currInst->roi[ROI_COL] = value->par.l;
+        if(!currInst->roi_deferred)
+            return SetRoi(fginst, currInst->roi);
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI))
+    {
+        if(num != 4)
+            return H_ERR_FGPARV;
+        for(i = 0; i < 4; i++)
+            if(value[i].type != LONG_PAR)
+                return H_ERR_FGPART;
+        /* values staged for apply_roi are not silently replaced */
+        GetRoi(fginst, roi);
+        if(currInst->roi_deferred && memcmp(roi, currInst->roi, sizeof(roi)))
+            return H_ERR_FGPARNA;
+        for(i = 0; i < 4; i++)
+            currInst->roi[i] = value[i].par.l;
+        return SetRoi(fginst, currInst->roi);
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI_DEFERRED))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+        {
+            if(!currInst->roi_deferred)
+                GetRoi(fginst, currInst->roi);
+            currInst->roi_deferred = TRUE;
+        }
+        else if(!strcasecmp(value->par.s, "disable"))
+            currInst->roi_deferred = FALSE;
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_REFRESH_REGISTERS))
+        LoadRegisters(currInst);
+    else if(!strcasecmp(param, FG_PARAM_APPLY_ROI))
+    {
+        if(currInst->roi_deferred)
+            return SetRoi(fginst, currInst->roi);
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < 0 || value->par.l > GRAB_TIMEOUT_MAX)
+            return H_ERR_FGPARV;
+        currInst->grab_timeout = value->par.l;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BUFFER_COUNT))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < GrabFrames(currInst) || value->par.l > BUFFER_COUNT_MAX)
+            return H_ERR_FGPARV;
+        return SetBufferCount(fginst, value->par.l);
+    }
+    else if(!strcasecmp(param, FG_PARAM_BURST_LENGTH))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < 1 || value->par.l > BURST_LENGTH_MAX)
+            return H_ERR_FGPARV;
+        if(value->par.l > 1 && (currInst->color || currInst->average_frames > 1 || currInst->sync_group > 0))
+            return H_ERR_FGPARNA;
+        /* the ring must be able to hold a whole burst */
+        if(value->par.l > currInst->buffer_count)
+            HCkP(SetBufferCount(fginst, value->par.l));
+        currInst->burst_length = value->par.l;
+        currInst->async_started = FALSE;
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_MODE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 3; i++)
+            if(!strcasecmp(value->par.s, trigger_modes[i]))
+                break;
+        if(i == 3)
+            return H_ERR_FGPARV;
+        if(CameraSetTrigger(currInst, TRIG_STOP) != 0
+           || (i == TRIGGER_SOFTWARE && CameraSetTrigger(currInst, TRIG_SW_START) != 0)
+           || (i == TRIGGER_HARDWARE && CameraSetTrigger(currInst, TRIG_HW_START) != 0))
+        {
+            MY_PRINT_ERROR_MESSAGE("set trigger mode failed")
+            return H_ERR_FGSETPAR;
+        }
+        currInst->trigger_mode = i;
+        currInst->trigger_seq = currInst->trigger_due = ATOMIC_LOAD(currInst->seq);
+        currInst->async_started = FALSE;
+        fginst->external_trigger = (i == TRIGGER_HARDWARE);
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_AHEAD))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+            currInst->trigger_ahead = TRUE;
+        else if(!strcasecmp(value->par.s, "disable"))
+            currInst->trigger_ahead = FALSE;
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_OVERFLOW))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 2; i++)
+            if(!strcasecmp(value->par.s, queue_overflows[i]))
+                break;
+        if(i == 2)
+            return H_ERR_FGPARV;
+        currInst->queue_overflow = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_MODE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 3; i++)
+            if(!strcasecmp(value->par.s, grab_modes[i]))
+                break;
+        if(i == 3)
+            return H_ERR_FGPARV;
+        currInst->grab_mode = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_VOLATILE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+            currInst->volatile_mode = TRUE;
+        else if(!strcasecmp(value->par.s, "disable"))
+        {
+            currInst->volatile_mode = FALSE;
+            ReleaseDelivered(currInst);
+        }
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+            currInst->statistics = TRUE;
+        else if(!strcasecmp(value->par.s, "disable"))
+        {
+            currInst->statistics = FALSE;
+            ClearStatistics(&currInst->pixel_stats, 8);
+        }
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS_WINDOW))
+    {
+        if(num != 4)
+            return H_ERR_FGPARV;
+        for(i = 0; i < 4; i++)
+        {
+            if(value[i].type != LONG_PAR)
+                return H_ERR_FGPART;
+            if(value[i].par.l < 0)
+                return H_ERR_FGPARV;
+        }
+        for(i = 0; i < 4; i++)
+            currInst->stats_window[i] = value[i].par.l;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+        {
+            r = FindRegister(REG_EXPOSURE_TIME);
+            if(!currInst->reg[r].valid)
+                return H_ERR_FGPARNA;
+            /* the camera must not steer against the host */
+            auto_off.type = STRING_PAR;
+            auto_off.par.s = "false";
+            if(currInst->reg[r].auto_valid)
+                HCkP(SetRegister(currInst, r, REGISTER_AUTO, &auto_off));
+            r = FindRegister(REG_GAIN);
+            if(currInst->reg[r].auto_valid)
+                HCkP(SetRegister(currInst, r, REGISTER_AUTO, &auto_off));
+            currInst->host_exposure = TRUE;
+            currInst->exposure_seq = ATOMIC_LOAD(currInst->seq);
+        }
+        else if(!strcasecmp(value->par.s, "disable"))
+            currInst->host_exposure = FALSE;
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_TARGET))
+    {
+        if(value->type == LONG_PAR)
+            f = (double)value->par.l;
+        else if(value->type == FLOAT_PAR)
+            f = value->par.f;
+        else
+            return H_ERR_FGPART;
+        if(f <= 0.0 || f > 255.0)
+            return H_ERR_FGPARV;
+        currInst->exposure_target = f;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_STEP))
+    {
+        if(value->type == LONG_PAR)
+            f = (double)value->par.l;
+        else if(value->type == FLOAT_PAR)
+            f = value->par.f;
+        else
+            return H_ERR_FGPART;
+        if(f <= 1.0)
+            return H_ERR_FGPARV;
+        currInst->exposure_step = f;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_SETTLE))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < 0 || value->par.l > BUFFER_COUNT_MAX)
+            return H_ERR_FGPARV;
+        currInst->exposure_settle = value->par.l;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l != 1 && value->par.l != 2 && value->par.l != BINNING_MAX)
+            return H_ERR_FGPARV;
+        /* only 8-bit raw frames are reduced */
+        if(value->par.l > 1 && (currInst->color || fginst->bits_per_channel > 8 || currInst->average_frames > 1))
+            return H_ERR_FGPARNA;
+        currInst->binning = value->par.l;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_MODE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 2; i++)
+            if(!strcasecmp(value->par.s, binning_modes[i]))
+                break;
+        if(i == 2)
+            return H_ERR_FGPARV;
+        currInst->binning_mode = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_FRAMES))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < 1 || value->par.l > AVERAGE_FRAMES_MAX)
+            return H_ERR_FGPARV;
+        /* averaging replaces bursts and reduction */
+        if(value->par.l > 1 && (currInst->color || currInst->burst_length > 1 || currInst->binning > 1 || currInst->sync_group > 0))
+            return H_ERR_FGPARNA;
+        /* the ring must be able to hold the frames of a whole average */
+        if(value->par.l > currInst->buffer_count)
+            HCkP(SetBufferCount(fginst, value->par.l));
+        currInst->average_frames = value->par.l;
+        currInst->async_started = FALSE;
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_OUTPUT))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 2; i++)
+            if(!strcasecmp(value->par.s, average_outputs[i]))
+                break;
+        if(i == 2)
+            return H_ERR_FGPARV;
+        currInst->average_output = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_CORRECTION))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+            currInst->correction = TRUE;
+        else if(!strcasecmp(value->par.s, "disable"))
+            currInst->correction = FALSE;
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_LUT_FILE) || !strcasecmp(param, FG_PARAM_FLAT_FIELD_FILE)
+            || !strcasecmp(param, FG_PARAM_DARK_FIELD_FILE) || !strcasecmp(param, FG_PARAM_DEFECT_FILE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(param, FG_PARAM_LUT_FILE))
+            i = CorrectionLoadLut(&currInst->corr, value->par.s);
+        else if(!strcasecmp(param, FG_PARAM_FLAT_FIELD_FILE))
+            i = CorrectionLoadFlat(&currInst->corr, value->par.s);
+        else if(!strcasecmp(param, FG_PARAM_DARK_FIELD_FILE))
+            i = CorrectionLoadDark(&currInst->corr, value->par.s);
+        else
+            i = CorrectionLoadDefects(&currInst->corr, value->par.s);
+        if(i != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("cannot load correction file")
+            return H_ERR_FGPARV;
+        }
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_GROUP))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l < 0 || value->par.l > FG_MAX_INST)
+            return H_ERR_FGPARV;
+        /* a group grab takes one gray frame from each camera */
+        if(value->par.l > 0 && (currInst->color || GrabFrames(currInst) > 1))
+            return H_ERR_FGPARNA;
+        /* the change is published last: grabs of the new group may take
+           the camera from then on, while its own lock is still held */
+        currInst->async_started = FALSE;
+        ATOMIC_STORE(currInst->sync_group, value->par.l);
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_MATCH))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 2; i++)
+            if(!strcasecmp(value->par.s, sync_matches[i]))
+                break;
+        if(i == 2)
+            return H_ERR_FGPARV;
+        currInst->sync_match = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_TOLERANCE))
+    {
+        if(value->type == LONG_PAR)
+            f = (double)value->par.l;
+        else if(value->type == FLOAT_PAR)
+            f = value->par.f;
+        else
+            return H_ERR_FGPART;
+        if(f < 0.0)
+            return H_ERR_FGPARV;
+        currInst->sync_tolerance = f;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+        {
+            if(currInst->recorder.running)
+                return H_MSG_OK;
+            if(!currInst->record_file[0])
+                return H_ERR_FGPARNA;
+            if(RecorderStart(&currInst->recorder, currInst->record_file) != 0)
+            {
+                MY_PRINT_ERROR_MESSAGE("create recording failed")
+                return H_ERR_FGSETPAR;
+            }
+        }
+        else if(!strcasecmp(value->par.s, "disable"))
+        {
+            if(RecorderStop(&currInst->recorder) != 0)
+            {
+                MY_PRINT_ERROR_MESSAGE("recording incomplete")
+                return H_ERR_FGSETPAR;
+            }
+        }
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_FILE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(strlen(value->par.s) >= RECORD_PATH_MAX)
+            return H_ERR_FGPARV;
+        strcpy(currInst->record_file, value->par.s);
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_TIMING))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i <= PLAYBACK_MAX; i++)
+            if(!strcasecmp(value->par.s, playback_timings[i]))
+                break;
+        if(i > PLAYBACK_MAX)
+            return H_ERR_FGPARV;
+        ATOMIC_STORE(currInst->player.timing, i);
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_RATE))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        if(value->type == LONG_PAR)
+            f = (double)value->par.l;
+        else if(value->type == FLOAT_PAR)
+            f = value->par.f;
+        else
+            return H_ERR_FGPART;
+        if(f <= 0.0)
+            return H_ERR_FGPARV;
+        __atomic_store(&currInst->player.rate, &f, __ATOMIC_RELAXED);
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_LOOP))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "enable"))
+            ATOMIC_STORE(currInst->player.loop, TRUE);
+        else if(!strcasecmp(value->par.s, "disable"))
+            ATOMIC_STORE(currInst->player.loop, FALSE);
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RESET_STATISTICS))
+    {
+        ResetStatistics(&currInst->stats);
+    }
+    else if(!strcasecmp(param, FG_PARAM_BITS_PER_CHANNEL))
+    {
+        if(value->type != LONG_PAR)
+            return H_ERR_FGPART;
+        if(value->par.l != 8 && value->par.l != 10 && value->par.l != 12)
+            return H_ERR_FGPARV;
+        if(value->par.l > 8 && (currInst->color || currInst->binning > 1))
+            return H_ERR_FGPARNA;
+        if(value->par.l == fginst->bits_per_channel)
+            return H_MSG_OK;
+        /* the camera's own setting decides the bits it delivers, so one
+           deep precision is not relabelled as another */
+        if(value->par.l > 8 && fginst->bits_per_channel > 8)
+            return H_ERR_FGPARNA;
+        /* a recording holds frames of one depth */
+        if(currInst->player.data)
+            return H_ERR_FGPARNA;
+        /* the buffers change between one and two bytes per pixel */
+        if(CameraStop(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("stop camera failed")
+            return H_ERR_FGSETPAR;
+        }
+        fginst->bits_per_channel = value->par.l;
+        if(AllocateImage(fginst) != 0)
+            return H_ERR_MEM;
+        if(CameraStart(currInst) != 0)
+        {
+            MY_PRINT_ERROR_MESSAGE("restart camera failed")
+            return H_ERR_FGSETPAR;
+        }
+    }
+    else if(!strcasecmp(param, FG_PARAM_COLOR_SPACE))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        if(!strcasecmp(value->par.s, "rgb"))
+        {
+            /* bursts use the channels for consecutive frames */
+            if(GrabFrames(currInst) > 1 || fginst->bits_per_channel > 8 || currInst->binning > 1 || currInst->sync_group > 0)
+                return H_ERR_FGPARNA;
+            currInst->color = TRUE;
+        }
+        /* the camera's native output is the raw Bayer image */
+        else if(!strcasecmp(value->par.s, "gray") || !strcasecmp(value->par.s, "default"))
+            currInst->color = FALSE;
+        else
+            return H_ERR_FGPARV;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_PATTERN))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 4; i++)
+            if(!strcasecmp(value->par.s, bayer_patterns[i]))
+                break;
+        if(i == 4)
+            return H_ERR_FGPARV;
+        currInst->bayer_pattern = i;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_INTERPOLATION))
+    {
+        if(value->type != STRING_PAR)
+            return H_ERR_FGPART;
+        for(i = 0; i < 2; i++)
+            if(!strcasecmp(value->par.s, bayer_interpolations[i]))
+                break;
+        if(i == 2)
+            return H_ERR_FGPARV;
+        currInst->bayer_interpolation = i;
+    }
+    else if((r = FindRegisterParam(param, &kind)) >= 0)
+        return SetRegister(currInst, r, kind, value);
+    else
+        return H_ERR_FGPARAM;
+
+    return H_MSG_OK;
+}
+
+static Herror FGSetParam(Hproc_handle proc_id, FGInstance * fginst, char * param, Hcpar * value, INT num)
+{
+    TFGLock * lock = LockInstance((TFGInstance *)fginst->gen_pointer);
+    Herror err;
+
+    /* a change may stop the camera, reallocate the buffers that a running
+       grab reads, or release a buffer a grab holds */
+    err = SetParam(proc_id, fginst, param, value, num);
+    GiveLock(lock);
+
+    return err;
+}
+
+static Herror FGGetParam(Hproc_handle proc_id, FGInstance * fginst, char * param, Hcpar * value, INT * num)
+{
+    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
+    INT i, k, r, kind, roi[4], shift, gray_min, gray_max;
+    UINT saturated;
+    double mean;
+    float f;
+
+    *num = 1;
+
+    if(!strcasecmp(param, FG_PARAM_HORIZONTAL_RESOLUTION))
+    {
+        value->type = LONG_PAR;
+        value->par.l = fginst->horizontal_resolution;
+    }
+    else if(!strcasecmp(param, FG_PARAM_VERTICAL_RESOLUTION))
+    {
+        value->type = LONG_PAR;
+        value->par.l = fginst->vertical_resolution;
+    }
+    else if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH) || !strcasecmp(param, FG_PARAM_IMAGE_HEIGHT)
+            || !strcasecmp(param, FG_PARAM_START_ROW) || !strcasecmp(param, FG_PARAM_START_COL))
+    {
+        /* in deferred mode, the values staged for apply_roi */
+        if(currInst->roi_deferred)
+            memcpy(roi, currInst->roi, sizeof(roi));
+        else
+            GetRoi(fginst, roi);
+        value->type = LONG_PAR;
+        if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH))
+            value->par.l = roi[ROI_WIDTH];
+        else if(!strcasecmp(param, FG_PARAM_IMAGE_HEIGHT))
+            value->par.l = roi[ROI_HEIGHT];
+        else if(!strcasecmp(param, FG_PARAM_START_ROW))
+            value->par.l = roi[ROI_ROW];
+        else
+            value->par.l = roi[ROI_COL];
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI))
+    {
+        GetRoi(fginst, roi);
+        for(i = 0; i < 4; i++)
+        {
+            value[i].type = LONG_PAR;
+            value[i].par.l = roi[i];
+        }
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI_DEFERRED))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->roi_deferred ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_INDEX))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->index;
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->grab_timeout;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BUFFER_COUNT))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->buffer_count;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BURST_LENGTH))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->burst_length;
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_MODE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = trigger_modes[currInst->trigger_mode];
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_AHEAD))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->trigger_ahead ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_OVERFLOW))
+    {
+        value->type = STRING_PAR;
+        value->par.s = queue_overflows[currInst->queue_overflow];
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_MODE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = grab_modes[currInst->grab_mode];
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_LEVEL))
+    {
+        value->type = LONG_PAR;
+        value->par.l = 0;
+        for(i = 0; i < currInst->buffer_count; i++)
+            if(ATOMIC_LOAD(currInst->buffer[i].state) == BUFFER_FILLED)
+                value->par.l++;
+    }
+    else if(!strcasecmp(param, FG_PARAM_VOLATILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->volatile_mode ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->binning;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_MODE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = binning_modes[currInst->binning_mode];
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_FRAMES))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->average_frames;
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_OUTPUT))
+    {
+        value->type = STRING_PAR;
+        value->par.s = average_outputs[currInst->average_output];
+    }
+    else if(!strcasecmp(param, FG_PARAM_CORRECTION))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->correction ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_LUT_FILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->corr.lut_file;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FLAT_FIELD_FILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->corr.flat_file;
+    }
+    else if(!strcasecmp(param, FG_PARAM_DARK_FIELD_FILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->corr.dark_file;
+    }
+    else if(!strcasecmp(param, FG_PARAM_DEFECT_FILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->corr.defect_file;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_GROUP))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->sync_group;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_MATCH))
+    {
+        value->type = STRING_PAR;
+        value->par.s = sync_matches[currInst->sync_match];
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_TOLERANCE))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->sync_tolerance;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_SKEW))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->sync_skew;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->recorder.running ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_FILE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->record_file;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_FRAMES))
+    {
+        value->type = LONG_PAR;
+        value->par.l = ATOMIC_LOAD(currInst->recorder.written);
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_DROPPED))
+    {
+        value->type = LONG_PAR;
+        value->par.l = ATOMIC_LOAD(currInst->recorder.dropped);
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_TIMING))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        value->type = STRING_PAR;
+        value->par.s = playback_timings[ATOMIC_LOAD(currInst->player.timing)];
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_RATE))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        value->type = FLOAT_PAR;
+        __atomic_load(&currInst->player.rate, &value->par.f, __ATOMIC_RELAXED);
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_LOOP))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        value->type = STRING_PAR;
+        value->par.s = ATOMIC_LOAD(currInst->player.loop) ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_FRAMES))
+    {
+        if(!currInst->player.data)
+            return H_ERR_FGPARNA;
+        value->type = LONG_PAR;
+        value->par.l = ATOMIC_LOAD(currInst->player.played);
+    }
+    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_MSEC))
+    {
+        value->type = FLOAT_PAR;
+        if(currInst->player.data || NETUSBCAM_GetExposure(currInst->index, &f) != 0)
+            return H_ERR_FGGETPAR;
+        value->par.f = f;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BITS_PER_CHANNEL))
+    {
+        value->type = LONG_PAR;
+        value->par.l = fginst->bits_per_channel;
+    }
+    else if(!strcasecmp(param, FG_PARAM_COLOR_SPACE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->color ? "rgb" : "gray";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_PATTERN))
+    {
+        value->type = STRING_PAR;
+        value->par.s = bayer_patterns[currInst->bayer_pattern];
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_INTERPOLATION))
+    {
+        value->type = STRING_PAR;
+        value->par.s = bayer_interpolations[currInst->bayer_interpolation];
+    }
+    else if(!strcasecmp(param, FG_PARAM_CONVERSION_TIME))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->conversion_time;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_SEQUENCE))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->stats.last_seq;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_TRIGGER))
+    {
+        /* 0 until a frame is delivered after the trigger mode was set */
+        value->type = LONG_PAR;
+        value->par.l = SEQ_BEFORE(currInst->stats.last_seq, currInst->trigger_seq + 1) ? 0 : (INT)(currInst->stats.last_seq - currInst->trigger_seq);
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_TIMESTAMP))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->stats.last_time;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_AGE))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->stats.last_age;
+    }
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->statistics ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS_WINDOW))
+    {
+        for(i = 0; i < 4; i++)
+        {
+            value[i].type = LONG_PAR;
+            value[i].par.l = currInst->stats_window[i];
+        }
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE))
+    {
+        value->type = STRING_PAR;
+        value->par.s = currInst->host_exposure ? "enable" : "disable";
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_TARGET))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->exposure_target;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_STEP))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->exposure_step;
+    }
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_SETTLE))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->exposure_settle;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_HISTOGRAM))
+    {
+        if(!currInst->pixel_stats.count)
+            return H_ERR_FGPARNA;
+        /* bins of the upper bits, merged further if they do not fit */
+        for(k = HISTOGRAM_BINS, shift = currInst->pixel_stats.depth - 8; k > FG_MAX_PARAM; k /= 2)
+            shift++;
+        for(i = 0; i < k; i++)
+        {
+            value[i].par.l = 0;
+            value[i].type = LONG_PAR;
+        }
+        for(i = 0; i < 1 << currInst->pixel_stats.depth; i++)
+            value[i >> shift].par.l += currInst->pixel_stats.histogram[i];
+        *num = k;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAME_MEAN) || !strcasecmp(param, FG_PARAM_FRAME_MIN)
+            || !strcasecmp(param, FG_PARAM_FRAME_MAX) || !strcasecmp(param, FG_PARAM_FRAME_SATURATED))
+    {
+        if(!SummarizeStatistics(&currInst->pixel_stats, &mean, &gray_min, &gray_max, &saturated))
+            return H_ERR_FGPARNA;
+        value->type = LONG_PAR;
+        if(!strcasecmp(param, FG_PARAM_FRAME_MEAN))
+        {
+            value->type = FLOAT_PAR;
+            value->par.f = mean;
+        }
+        else if(!strcasecmp(param, FG_PARAM_FRAME_MIN))
+            value->par.l = gray_min;
+        else if(!strcasecmp(param, FG_PARAM_FRAME_MAX))
+            value->par.l = gray_max;
+        else
+            value->par.l = saturated;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_RECEIVED))
+    {
+        value->type = LONG_PAR;
+        value->par.l = ATOMIC_LOAD(currInst->stats.received);
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_DELIVERED))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->stats.delivered;
+    }
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_DROPPED))
+    {
+        value->type = LONG_PAR;
+        value->par.l = ATOMIC_LOAD(currInst->stats.dropped);
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUTS))
+    {
+        value->type = LONG_PAR;
+        value->par.l = currInst->stats.timeouts;
+    }
+    else if(!strcasecmp(param, FG_PARAM_LATENCY_AVG))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->stats.delivered ? currInst->stats.latency_sum / currInst->stats.delivered : 0.0;
+    }
+    else if(!strcasecmp(param, FG_PARAM_LATENCY_MAX))
+    {
+        value->type = FLOAT_PAR;
+        value->par.f = currInst->stats.latency_max;
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT_RANGE))
+    {
+        for(i = 0; i < 4; i++)
+            value[i].type = LONG_PAR;
+        value[0].par.l = 0;
+        value[1].par.l = GRAB_TIMEOUT_MAX;
+        value[2].par.l = 10;
+        value[3].par.l = GRAB_TIMEOUT_DEFAULT;
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BUFFER_COUNT_RANGE))
+    {
+        for(i = 0; i < 4; i++)
+            value[i].type = LONG_PAR;
+        value[0].par.l = 1;
+        value[1].par.l = BUFFER_COUNT_MAX;
+        value[2].par.l = 1;
+        value[3].par.l = BUFFER_COUNT_DEFAULT;
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BURST_LENGTH_RANGE))
+    {
+        for(i = 0; i < 4; i++)
+            value[i].type = LONG_PAR;
+        value[0].par.l = 1;
+        value[1].par.l = BURST_LENGTH_MAX;
+        value[2].par.l = 1;
+        value[3].par.l = 1;
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_FRAMES_RANGE))
+    {
+        for(i = 0; i < 4; i++)
+            value[i].type = LONG_PAR;
+        value[0].par.l = 1;
+        value[1].par.l = AVERAGE_FRAMES_MAX;
+        value[2].par.l = 1;
+        value[3].par.l = 1;
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_GROUP_RANGE))
+    {
+        for(i = 0; i < 4; i++)
+            value[i].type = LONG_PAR;
+        value[0].par.l = 0;
+        value[1].par.l = FG_MAX_INST;
+        value[2].par.l = 1;
+        value[3].par.l = 0;
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_VOLATILE_VALUES) || !strcasecmp(param, FG_PARAM_STATISTICS_VALUES)
+            || !strcasecmp(param, FG_PARAM_HOST_EXPOSURE_VALUES) || !strcasecmp(param, FG_PARAM_CORRECTION_VALUES))
+    {
+        value[0].par.s = "disable";
+        value[0].type = STRING_PAR;
+        value[1].par.s = "enable";
+        value[1].type = STRING_PAR;
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_VALUES))
+    {
+        for(i = 0; i < 3; i++)
+        {
+            value[i].par.l = 1 << i;
+            value[i].type = LONG_PAR;
+        }
+        *num = 3;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_MODE_VALUES))
+    {
+        for(i = 0; i < 2; i++)
+        {
+            value[i].par.s = binning_modes[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_OUTPUT_VALUES))
+    {
+        for(i = 0; i < 2; i++)
+        {
+            value[i].par.s = average_outputs[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_MATCH_VALUES))
+    {
+        for(i = 0; i < 2; i++)
+        {
+            value[i].par.s = sync_matches[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_VALUES) || !strcasecmp(param, FG_PARAM_PLAYBACK_LOOP_VALUES))
+    {
+        value[0].par.s = "disable";
+        value[0].type = STRING_PAR;
+        value[1].par.s = "enable";
+        value[1].type = STRING_PAR;
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_TIMING_VALUES))
+    {
+        for(i = 0; i <= PLAYBACK_MAX; i++)
+        {
+            value[i].par.s = playback_timings[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = PLAYBACK_MAX + 1;
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_MODE_VALUES))
+    {
+        for(i = 0; i < 3; i++)
+        {
+            value[i].par.s = trigger_modes[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 3;
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_AHEAD_VALUES))
+    {
+        value[0].par.s = "disable";
+        value[0].type = STRING_PAR;
+        value[1].par.s = "enable";
+        value[1].type = STRING_PAR;
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_OVERFLOW_VALUES))
+    {
+        for(i = 0; i < 2; i++)
+        {
+            value[i].par.s = queue_overflows[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_MODE_VALUES))
+    {
+        for(i = 0; i < 3; i++)
+        {
+            value[i].par.s = grab_modes[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 3;
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI_DEFERRED_VALUES))
+    {
+        value[0].par.s = "disable";
+        value[0].type = STRING_PAR;
+        value[1].par.s = "enable";
+        value[1].type = STRING_PAR;
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_COLOR_SPACE_VALUES))
+    {
+        value[0].par.s = "gray";
+        value[0].type = STRING_PAR;
+        value[1].par.s = "rgb";
+        value[1].type = STRING_PAR;
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BITS_PER_CHANNEL_VALUES))
+    {
+        for(i = 0; i < 3; i++)
+        {
+            value[i].par.l = 8 + 2 * i;
+            value[i].type = LONG_PAR;
+        }
+        *num = 3;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_PATTERN_VALUES))
+    {
+        for(i = 0; i < 4; i++)
+        {
+            value[i].par.s = bayer_patterns[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 4;
+    }
+    else if(!strcasecmp(param, FG_PARAM_BAYER_INTERPOLATION_VALUES))
+    {
+        for(i = 0; i < 2; i++)
+        {
+            value[i].par.s = bayer_interpolations[i];
+            value[i].type = STRING_PAR;
+        }
+        *num = 2;
+    }
+    else if(!strcasecmp(param, FG_PARAM_INDEX_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Camera device index.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Grab timeout in milliseconds.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BUFFER_COUNT_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of frame buffers queued between camera and grab.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BURST_LENGTH_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of consecutive frames returned as channels by one grab.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_MODE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Free running camera, exposure triggered by each grab, or external trigger.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_TRIGGER_AHEAD_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Trigger the next exposure as soon as a software triggered grab returns.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_OVERFLOW_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Frame discarded when all buffers hold ungrabbed frames (drop_oldest discards the new frame too while a grab holds the remaining buffers).";
+    }
+    else if(!strcasecmp(param, FG_PARAM_GRAB_MODE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Frames returned by grab_image: the oldest queued, the newest queued (skipping older ones), or the next captured.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Image part as [width, height, row, column], applied with a single camera restart.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_ROI_DEFERRED_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Stage changes of image_width, image_height, start_row and start_column until apply_roi; meanwhile, they read back as staged, roi as applied, and roi cannot be set.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_APPLY_ROI_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Apply the staged image part.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_QUEUE_LEVEL_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of captured frames waiting to be grabbed.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_VOLATILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Grab without copying; images are valid until the next grab or parameter change.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Reduce grabbed images by this factor in both directions; grab_data returns the full and the reduced image.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_BINNING_MODE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Average the pixels of each block or keep its first pixel.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_FRAMES_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of consecutive frames averaged into each grabbed image.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_AVERAGE_OUTPUT_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Pixel type of averaged images: that of a frame, or uint2 keeping 16 significant bits of the average.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_CORRECTION_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Apply the flat-field, defect pixel and lookup table corrections loaded while copying frames (not to uint2 averages).";
+    }
+    else if(!strcasecmp(param, FG_PARAM_LUT_FILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Text file of 256, 1024 or 4096 output values, for frames of 8, 10 or 12 bits; empty for none.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_FLAT_FIELD_FILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Binary PGM image of a uniformly lit scene, of the image or sensor size; empty for none.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_DARK_FIELD_FILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Binary PGM image taken without light, subtracted before the flat-field gain; empty for none.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_DEFECT_FILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Text file of defect pixels, one 'row column' sensor position per line; empty for none.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_GROUP_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Synchronization group (0 for none): a grab on any camera of a group returns one matched frame of each, as channels.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_MATCH_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Match the frames of a group grab by trigger number (frame_trigger), or by host arrival time within sync_tolerance.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_TOLERANCE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Largest difference in milliseconds between the host arrival times of frames matched by timestamp.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_SYNC_SKEW_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Difference in milliseconds between the earliest and latest host arrival time of the last group grab.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Write every received raw frame to record_file in the background.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_FILE_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Raw frame file of the next recording; its index goes to the same name with '.idx' appended.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_FRAMES_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of frames written by the current or last recording.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RECORD_DROPPED_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Number of frames the current or last recording could not keep up with.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_TIMING_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->horizontal_resolution)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        ok = FALSE;
-        NETUSBCAM_GetModeList(currInst->index, &nmodes, modes);
-        for(i = 0; i < nmodes; i++)
-        {
-            if(value->par.l == modelist[modes[i]][0])
-            {
-                NETUSBCAM_SetMode(currInst->index, modes[i]);
-                fginst->horizontal_resolution = modelist[modes[i]][0];
-                fginst->vertical_resolution = modelist[modes[i]][1];
-                ok = TRUE;
-                break;
-            }
-        }
-        if(!ok)
-            return H_ERR_FGPARV;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Play a recording at its recorded frame times, at playback_rate, or as fast as grabs free the buffers.";
     }
-    else if(!strcasecmp(param, FG_PARAM_VERTICAL_RESOLUTION))
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_RATE_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->vertical_resolution)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        ok = FALSE;
-        NETUSBCAM_GetModeList(currInst->index, &nmodes, modes);
-        for(i = 0; i < nmodes; i++)
-        {
-            if(value->par.l == modelist[modes[i]][1])
-            {
-                NETUSBCAM_SetMode(currInst->index, modes[i]);
-                fginst->horizontal_resolution = modelist[modes[i]][0];
-                fginst->vertical_resolution = modelist[modes[i]][1];
-                ok = TRUE;
-                break;
-            }
-        }
-        if(!ok)
-            return H_ERR_FGPARV;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Frame rate of fixed playback timing in frames per second.";
     }
-    else if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH))
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_LOOP_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->image_width)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        NETUSBCAM_GetResolutionRange(currInst->index, &roi_range_property);
-        if(value->par.l < 1 || value->par.l > roi_range_property.nXMax - fginst->start_col)
-            return H_ERR_FGPARV;
-        fginst->image_width = value->par.l;
-        if(NETUSBCAM_SetResolution(currInst->index, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
-            return H_ERR_FGSETPAR;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Restart a recording after its last frame instead of stopping.";
     }
-    else if(!strcasecmp(param, FG_PARAM_IMAGE_HEIGHT))
+    else if(!strcasecmp(param, FG_PARAM_PLAYBACK_FRAMES_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->image_height)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        NETUSBCAM_GetResolutionRange(currInst->index, &roi_range_property);
-        if(value->par.l < 1 || value->par.l > roi_range_property.nYMax - fginst->start_row)
-            return H_ERR_FGPARV;
-        fginst->image_height = value->par.l;
-        if(NETUSBCAM_SetResolution(currInst->index, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
-            return H_ERR_FGSETPAR;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Number of frames played back since the recording was opened.";
     }
-    else if(!strcasecmp(param, FG_PARAM_START_COL))
+    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_MSEC_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->start_col)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        NETUSBCAM_GetResolutionRange(currInst->index, &roi_range_property);
-        if(value->par.l < roi_range_property.nXMin || value->par.l > roi_range_property.nXMax - fginst->image_width)
-            return H_ERR_FGPARV;
-        fginst->start_col = value->par.l;
-        if(NETUSBCAM_SetResolution(currInst->index, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
-            return H_ERR_FGSETPAR;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Exposure time in milliseconds.";
     }
-    else if(!strcasecmp(param, FG_PARAM_START_ROW))
+    else if(!strcasecmp(param, FG_PARAM_COLOR_SPACE_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l == fginst->start_row)
-            return H_MSG_OK;
-        if(NETUSBCAM_Stop(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("stop camera failed")
-            return H_ERR_FGSETPAR;
-        }
-        NETUSBCAM_GetResolutionRange(currInst->index, &roi_range_property);
-        if(value->par.l < roi_range_property.nYMin || value->par.l > roi_range_property.nYMax - fginst->image_width)
-            return H_ERR_FGPARV;
-        fginst->start_row = value->par.l;
-        if(NETUSBCAM_SetResolution(currInst->index, fginst->image_width, fginst->image_height, fginst->start_col, fginst->start_row) != 0)
-            return H_ERR_FGSETPAR;
-        if(AllocateImage(fginst) != 0)
-            return H_ERR_MEM;
-        if(NETUSBCAM_Start(currInst->index) != 0)
-        {
-            MY_PRINT_ERROR_MESSAGE("restart camera failed")
-            return H_ERR_FGSETPAR;
-        }
+        value->type = STRING_PAR;
+        value->par.s = "Return the raw Bayer image ('gray' or 'default') or demosaic it ('rgb').";
     }
-    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT))
+    else if(!strcasecmp(param, FG_PARAM_BITS_PER_CHANNEL_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        if(value->par.l < 0 || value->par.l > GRAB_TIMEOUT_MAX)
-            return H_ERR_FGPARV;
-        currInst->grab_timeout = value->par.l;
+        value->type = STRING_PAR;
+        value->par.s = "Bits per pixel of the raw data, as set on the camera; above 8, images are of type uint2.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TIME))
+    else if(!strcasecmp(param, FG_PARAM_BAYER_PATTERN_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        NETUSBCAM_GetParamAuto(currInst->index, REG_EXPOSURE_TIME, &i);
-        if(i)
-            return H_ERR_FGPARNA;
-        NETUSBCAM_GetCamParameterRange(currInst->index, REG_EXPOSURE_TIME, &param_property);
-        if(value->par.l < param_property.nMin || value->par.l > param_property.nMax)
-            return H_ERR_FGPARV;
-        if(NETUSBCAM_SetCamParameter(currInst->index, REG_EXPOSURE_TIME, (unsigned long)value->par.l) != 0)
-            return H_ERR_FGSETPAR;
+        value->type = STRING_PAR;
+        value->par.s = "Bayer pattern of the sensor, by the colors of its first two pixels; images starting at an odd row or column are demosaiced accordingly.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_AUTO))
+    else if(!strcasecmp(param, FG_PARAM_BAYER_INTERPOLATION_DESCR))
     {
-        if(value->type != STRING_PAR)
-            return H_ERR_FGPART;
-        if(!strcasecmp(value->par.s, "true"))
-        {
-            if(NETUSBCAM_SetParamAuto(currInst->index, REG_EXPOSURE_TIME, 1) != 0)
-                return H_ERR_FGSETPAR;
-        }
-        else if(!strcasecmp(value->par.s, "false"))
-        {
-            if(NETUSBCAM_SetParamAuto(currInst->index, REG_EXPOSURE_TIME, 0) != 0)
-                return H_ERR_FGSETPAR;
-        }
-        else
-            return H_ERR_FGPARV;
+        value->type = STRING_PAR;
+        value->par.s = "Demosaicing method for 'rgb' color space.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TARGET))
+    else if(!strcasecmp(param, FG_PARAM_CONVERSION_TIME_DESCR))
     {
-        if(value->type != LONG_PAR)
-            return H_ERR_FGPART;
-        NETUSBCAM_GetCamParameterRange(currInst->index, REG_EXPOSURE_TARGET, &param_property);
-        if(value->par.l < param_property.nMin || value->par.l > param_property.nMax)
-            return H_ERR_FGPARV;
-        if(NETUSBCAM_SetCamParameter(currInst->index, REG_EXPOSURE_TARGET, (unsigned long)value->par.l) != 0)
-            return H_ERR_FGSETPAR;
+        value->type = STRING_PAR;
+        value->par.s = "Demosaicing time of the last frame in milliseconds.";
     }
-    else
-        return H_ERR_FGPARAM;
-
-    return H_MSG_OK;
-}
-
-static Herror FGGetParam(Hproc_handle proc_id, FGInstance * fginst, char * param, Hcpar * value, INT * num)
-{
-    TFGInstance * currInst = (TFGInstance *)fginst->gen_pointer;
-    INT i;
-    float f;
-    unsigned long ul;
-    PARAM_PROPERTY param_property;
-
-    *num = 1;
-
-    if(!strcasecmp(param, FG_PARAM_HORIZONTAL_RESOLUTION))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_SEQUENCE_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->horizontal_resolution;
+        value->type = STRING_PAR;
+        value->par.s = "Sequence number of the last delivered frame.";
     }
-    else if(!strcasecmp(param, FG_PARAM_VERTICAL_RESOLUTION))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_TRIGGER_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->vertical_resolution;
+        value->type = STRING_PAR;
+        value->par.s = "Number of frames received since the trigger mode was set, up to and including the last delivered frame (triggers lost before reaching the host are not counted).";
     }
-    else if(!strcasecmp(param, FG_PARAM_IMAGE_WIDTH))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_TIMESTAMP_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->image_width;
+        value->type = STRING_PAR;
+        value->par.s = "Monotonic capture time of the last delivered frame in milliseconds.";
     }
-    else if(!strcasecmp(param, FG_PARAM_IMAGE_HEIGHT))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_AGE_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->image_height;
+        value->type = STRING_PAR;
+        value->par.s = "Time from capture to delivery of the last frame in milliseconds.";
     }
-    else if(!strcasecmp(param, FG_PARAM_START_COL))
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->start_col;
+        value->type = STRING_PAR;
+        value->par.s = "Count the pixels of each delivered frame at full resolution while copying it (the raw Bayer frame for 'rgb').";
     }
-    else if(!strcasecmp(param, FG_PARAM_START_ROW))
+    else if(!strcasecmp(param, FG_PARAM_STATISTICS_WINDOW_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = fginst->start_row;
+        value->type = STRING_PAR;
+        value->par.s = "Window [width, height, row, column] of the frame counted for the statistics and host exposure control; all zero for the whole frame.";
     }
-    else if(!strcasecmp(param, FG_PARAM_INDEX))
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = currInst->index;
+        value->type = STRING_PAR;
+        value->par.s = "Steer exposure time and gain from the statistics of each delivered frame, instead of the camera's automatic exposure.";
     }
-    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT))
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_TARGET_DESCR))
     {
-        value->type = LONG_PAR;
-        value->par.l = currInst->grab_timeout;
+        value->type = STRING_PAR;
+        value->par.s = "Mean gray value, on the 8-bit scale, that host exposure control aims for.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TIME))
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_STEP_DESCR))
     {
-        value->type = LONG_PAR;
-        if(NETUSBCAM_GetCamParameter(currInst->index, REG_EXPOSURE_TIME, &ul) != 0)
-            return H_ERR_FGGETPAR;
-        value->par.l = ul;
+        value->type = STRING_PAR;
+        value->par.s = "Largest factor by which host exposure control changes the exposure in one step.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_AUTO))
+    else if(!strcasecmp(param, FG_PARAM_HOST_EXPOSURE_SETTLE_DESCR))
     {
         value->type = STRING_PAR;
-        if(NETUSBCAM_GetParamAuto(currInst->index, REG_EXPOSURE_TIME, &i) != 0)
-            return H_ERR_FGGETPAR;
-        value->par.s = i ? "true" : "false";
+        value->par.s = "Frames skipped after a change of exposure before host exposure control measures again.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TARGET))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_HISTOGRAM_DESCR))
     {
-        value->type = LONG_PAR;
-        if(NETUSBCAM_GetCamParameter(currInst->index, REG_EXPOSURE_TARGET, &ul) != 0)
-            return H_ERR_FGGETPAR;
-        value->par.l = ul;
+        value->type = STRING_PAR;
+        value->par.s = "Histogram of the last delivered frame over the upper 8 bits of its pixels.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_MSEC))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_MEAN_DESCR))
     {
-        value->type = FLOAT_PAR;
-        if(NETUSBCAM_GetExposure(currInst->index, &f) != 0)
-            return H_ERR_FGGETPAR;
-        value->par.f = f;
+        value->type = STRING_PAR;
+        value->par.s = "Mean gray value of the last delivered frame.";
     }
-    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT_RANGE))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_MIN_DESCR))
     {
-        for(i = 0; i < 4; i++)
-            value[i].type = LONG_PAR;
-        value[0].par.l = 0;
-        value[1].par.l = GRAB_TIMEOUT_MAX;
-        value[2].par.l = 10;
-        value[3].par.l = GRAB_TIMEOUT_DEFAULT;
-        *num = 4;
+        value->type = STRING_PAR;
+        value->par.s = "Minimum gray value of the last delivered frame.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TIME_RANGE))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_MAX_DESCR))
     {
-        if(NETUSBCAM_GetCamParameterRange(currInst->index, REG_EXPOSURE_TIME, &param_property) != 0)
-            return H_ERR_FGGETPAR;
-        for(i = 0; i < 4; i++)
-            value[i].type = LONG_PAR;
-        value[0].par.l = param_property.nMin;
-        value[1].par.l = param_property.nMax;
-        value[2].par.l = 1;
-        value[3].par.l = param_property.nDef;
-        *num = 4;
+        value->type = STRING_PAR;
+        value->par.s = "Maximum gray value of the last delivered frame.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TARGET_RANGE))
+    else if(!strcasecmp(param, FG_PARAM_FRAME_SATURATED_DESCR))
     {
-        if(NETUSBCAM_GetCamParameterRange(currInst->index, REG_EXPOSURE_TARGET, &param_property) != 0)
-            return H_ERR_FGGETPAR;
-        for(i = 0; i < 4; i++)
-            value[i].type = LONG_PAR;
-        value[0].par.l = param_property.nMin;
-        value[1].par.l = param_property.nMax;
-        value[2].par.l = 1;
-        value[3].par.l = param_property.nDef;
-        *num = 4;
+        value->type = STRING_PAR;
+        value->par.s = "Number of pixels of the last delivered frame at the largest value of its depth.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_AUTO_VALUES))
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_RECEIVED_DESCR))
     {
-        value[0].par.s = "false";
-        value[0].type = STRING_PAR;
-        value[1].par.s = "true";
-        value[1].type = STRING_PAR;
-        *num = 2;
+        value->type = STRING_PAR;
+        value->par.s = "Number of frames received from the camera.";
     }
-    else if(!strcasecmp(param, FG_PARAM_INDEX_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_DELIVERED_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Camera device index.";
+        value->par.s = "Number of frames delivered by grabs.";
     }
-    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUT_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_FRAMES_DROPPED_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Grab timeout in milliseconds.";
+        value->par.s = "Number of frames overwritten or discarded before delivery.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TIME_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_GRAB_TIMEOUTS_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Exposure time.";
+        value->par.s = "Number of grabs that timed out.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_AUTO_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_LATENCY_AVG_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Toggle automatic exposure.";
+        value->par.s = "Average time from capture to delivery in milliseconds.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_TARGET_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_LATENCY_MAX_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Target brightness for automatic exposure.";
+        value->par.s = "Maximum time from capture to delivery in milliseconds.";
     }
-    else if(!strcasecmp(param, FG_PARAM_EXPOSURE_MSEC_DESCR))
+    else if(!strcasecmp(param, FG_PARAM_REFRESH_REGISTERS_DESCR))
     {
         value->type = STRING_PAR;
-        value->par.s = "Exposure time in milliseconds.";
+        value->par.s = "Reload the cached camera register values and ranges.";
+    }
+    else if(!strcasecmp(param, FG_PARAM_RESET_STATISTICS_DESCR))
+    {
+        value->type = STRING_PAR;
+        value->par.s = "Reset the frame counters and latency statistics.";
     }
+    else if((r = FindRegisterParam(param, &kind)) >= 0)
+        return GetRegister(currInst, r, kind, value, num);
     else
         return H_ERR_FGPARAM;
 
@@ -756,14 +4246,24 @@ static Herror FGGetParam(Hproc_handle proc_id, FGInstance * fginst, char * param
 
 static FGInstance ** FGOpenRequest(Hproc_handle proc_id, FGInstance * fginst)
 {
-    /* support only a single instance */
-    fginst->gen_pointer = ( void * )&FGInst;
-    return &( fgClass->instance[ 0 ] );
+    INT i;
+
+    /* one instance slot (with its own buffers and lock) per open camera */
+    for(i = 0; i < FG_MAX_INST; i++)
+    {
+        if(!fgClass->instance[i] && !FGInst[i].open)
+        {
+            fginst->gen_pointer = (void *)&FGInst[i];
+            return &(fgClass->instance[i]);
+        }
+    }
+
+    return NULL;
 }
 
 Herror FGInit(Hproc_handle proc_id, FGClass * fg)
 {
-    INT i;
+    INT i, j;
 
     fg->interface_version = FG_INTERFACE_VERSION;
 
@@ -779,24 +4279,88 @@ Herror FGInit(Hproc_handle proc_id, FGClass * fg)
     fg->Grab = FGGrab;
     fg->GrabStartAsync = FGGrabStartAsync;
     fg->GrabAsync = FGGrabAsync;
+    fg->GrabData = FGGrabData;
+    fg->GrabDataAsync = FGGrabDataAsync;
     fg->SetParam = FGSetParam;
     fg->GetParam = FGGetParam;
 
     fgClass = fg;
 
+    /* pixel kernels for the instruction sets of this CPU */
+    SelectKernels();
+
     for(i = 0; i < FG_MAX_INST; i++)
     {
         FGInst[i].index = i;
         FGInst[i].grab_timeout = GRAB_TIMEOUT_DEFAULT;
-        FGInst[i].image = NULL;
+        FGInst[i].buffer_count = BUFFER_COUNT_DEFAULT;
+        FGInst[i].burst_length = 1;
+        for(j = 0; j < BUFFER_COUNT_MAX; j++)
+        {
+            FGInst[i].buffer[j].image = NULL;
+            FGInst[i].buffer[j].size = 0;
+            FGInst[i].buffer[j].length = 0;
+            FGInst[i].buffer[j].state = BUFFER_FREE;
+            FGInst[i].buffer[j].seq = 0;
+            FGInst[i].buffer[j].time = 0.0;
+        }
+        FGInst[i].buffer_size = 0;
+        FGInst[i].seq = 0;
+        FGInst[i].done = 0;
+        FGInst[i].waiting = 0;
+        FGInst[i].async_started = FALSE;
+        FGInst[i].async_seq = 0;
+        FGInst[i].trigger_mode = TRIGGER_FREE_RUN;
+        FGInst[i].trigger_ahead = FALSE;
+        FGInst[i].trigger_seq = 0;
+        FGInst[i].trigger_due = 0;
+        FGInst[i].trigger_time = 0.0;
+        FGInst[i].queue_overflow = OVERFLOW_DROP_OLDEST;
+        FGInst[i].grab_mode = GRAB_OLDEST;
+        FGInst[i].roi_deferred = FALSE;
+        FGInst[i].volatile_mode = FALSE;
+        FGInst[i].delivered = -1;
+        FGInst[i].binning = 1;
+        FGInst[i].binning_mode = REDUCE_AVERAGE;
+        FGInst[i].average_frames = 1;
+        FGInst[i].average_output = AVERAGE_FRAME;
+        FGInst[i].correction = FALSE;
+        CorrectionInit(&FGInst[i].corr);
+        FGInst[i].scratch = NULL;
+        FGInst[i].scratch_size = 0;
+        FGInst[i].sync_group = 0;
+        FGInst[i].sync_match = SYNC_TRIGGER;
+        FGInst[i].sync_tolerance = SYNC_TOLERANCE_DEFAULT;
+        FGInst[i].sync_skew = 0.0;
+        FGInst[i].statistics = FALSE;
+        ClearStatistics(&FGInst[i].pixel_stats, 8);
+        memset(FGInst[i].stats_window, 0, sizeof(FGInst[i].stats_window));
+        FGInst[i].host_exposure = FALSE;
+        FGInst[i].exposure_target = EXPOSURE_TARGET_DEFAULT;
+        FGInst[i].exposure_step = EXPOSURE_STEP_DEFAULT;
+        FGInst[i].exposure_settle = EXPOSURE_SETTLE_DEFAULT;
+        FGInst[i].exposure_seq = 0;
+        RecorderInit(&FGInst[i].recorder);
+        FGInst[i].record_file[0] = '\0';
+        FGInst[i].color = FALSE;
+        FGInst[i].bayer_pattern = BAYER_RG;
+        FGInst[i].bayer_interpolation = DEMOSAIC_BILINEAR;
+        FGInst[i].conversion_time = 0.0;
+        FGInst[i].worker_running = FALSE;
+        FGInst[i].work_posted = 0;
+        FGInst[i].work_done = 0;
+        FGInst[i].work = NULL;
+        ResetStatistics(&FGInst[i].stats);
+        InitLock(&FGInst[i].lock);
+        FGInst[i].open = FALSE;
     }
+    for(i = 0; i <= FG_MAX_INST; i++)
+        InitLock(&group_lock[i]);
 
+    /* recordings can be played back without any camera */
     num_devices = NETUSBCAM_Init();
-    if(num_devices <= 0)
-    {
-        MY_PRINT_ERROR_MESSAGE("no camera detected")
-        return H_ERR_FGNI;
-    }
+    if(num_devices < 0)
+        num_devices = 0;
 
     return H_MSG_OK;
 }
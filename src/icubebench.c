@@ -0,0 +1,344 @@
+/** \file icubebench.c
+ * \brief Acquisition benchmark for the NET iCube HALCON interface.
+ *
+ * Opens one or more cameras through open_framegrabber, grabs a fixed
+ * number of frames per resolution mode and reports the frame rate, copy
+ * bandwidth, capture-to-return latency percentiles and histogram, and the
+ * drop and timeout counters of the interface. Run it against the
+ * simulated camera library ("make sim") for hardware-free numbers.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "HalconC.h"
+
+#define MAX_CAMERAS 16
+#define NUM_MODES 9
+#define NUM_BUCKETS 12
+
+static int modelist[NUM_MODES][2] = {
+    {320, 240},
+    {640, 480},
+    {752, 480},
+    {800, 600},
+    {1024, 768},
+    {1280, 1024},
+    {1600, 1200},
+    {2048, 1536},
+    {2592, 1944}
+};
+
+typedef struct
+{
+    Htuple handle;
+    int frames;
+    int async;
+    int grabbed;
+    int errors;
+    double elapsed;
+    double * latency;
+} TBenchCamera;
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int CompareDouble(const void * a, const void * b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static Herror SetParamInt(Htuple handle, const char * param, Hlong value)
+{
+    Htuple p, v;
+    Herror err;
+
+    create_tuple_s(&p, param);
+    create_tuple_i(&v, value);
+    err = T_set_framegrabber_param(handle, p, v);
+    destroy_tuple(p);
+    destroy_tuple(v);
+
+    return err;
+}
+
+static Herror SetParamString(Htuple handle, const char * param, const char * value)
+{
+    Htuple p, v;
+    Herror err;
+
+    create_tuple_s(&p, param);
+    create_tuple_s(&v, value);
+    err = T_set_framegrabber_param(handle, p, v);
+    destroy_tuple(p);
+    destroy_tuple(v);
+
+    return err;
+}
+
+static double GetParam(Htuple handle, const char * param)
+{
+    Htuple p, v;
+    double d = 0.0;
+
+    create_tuple_s(&p, param);
+    if(T_get_framegrabber_param(handle, p, &v) == H_MSG_TRUE)
+    {
+        d = get_type(v, 0) == LONG_PAR ? (double)get_i(v, 0) : get_d(v, 0);
+        destroy_tuple(v);
+    }
+    destroy_tuple(p);
+
+    return d;
+}
+
+static Herror OpenCamera(TBenchCamera * cam, int port, int mode, int buffers)
+{
+    Htuple t[16];
+    Herror err;
+    int i;
+
+    create_tuple_s(&t[0], "ICube");
+    create_tuple_i(&t[1], modelist[mode][0]);
+    create_tuple_i(&t[2], modelist[mode][1]);
+    create_tuple_i(&t[3], 0);
+    create_tuple_i(&t[4], 0);
+    create_tuple_i(&t[5], 0);
+    create_tuple_i(&t[6], 0);
+    create_tuple_s(&t[7], "default");
+    create_tuple_i(&t[8], -1);
+    create_tuple_s(&t[9], "default");
+    create_tuple_i(&t[10], -1);
+    create_tuple_s(&t[11], "false");
+    create_tuple_s(&t[12], "default");
+    create_tuple_s(&t[13], "default");
+    create_tuple_i(&t[14], port);
+    create_tuple_i(&t[15], -1);
+    err = T_open_framegrabber(t[0], t[1], t[2], t[3], t[4], t[5], t[6], t[7], t[8], t[9], t[10], t[11], t[12], t[13], t[14], t[15], &cam->handle);
+    for(i = 0; i < 16; i++)
+        destroy_tuple(t[i]);
+    if(err != H_MSG_TRUE)
+        return err;
+
+    /* a mode the camera does not offer is left unapplied, and the image
+       keeps the size of the current mode; skip it */
+    if((int)GetParam(cam->handle, "image_width") != modelist[mode][0]
+       || (int)GetParam(cam->handle, "image_height") != modelist[mode][1])
+    {
+        T_close_framegrabber(cam->handle);
+        destroy_tuple(cam->handle);
+        return H_ERR_FGPARV;
+    }
+
+    if(buffers > 0)
+        err = SetParamInt(cam->handle, "buffer_count", buffers);
+    if(err == H_MSG_TRUE)
+        err = SetParamString(cam->handle, "reset_statistics", "true");
+    if(err == H_MSG_TRUE && cam->async)
+    {
+        create_tuple_i(&t[0], -1);
+        err = T_grab_image_start(cam->handle, t[0]);
+        destroy_tuple(t[0]);
+    }
+    if(err != H_MSG_TRUE)
+    {
+        T_close_framegrabber(cam->handle);
+        destroy_tuple(cam->handle);
+    }
+
+    return err;
+}
+
+static void * GrabThread(void * arg)
+{
+    TBenchCamera * cam = (TBenchCamera *)arg;
+    Htuple delay;
+    Hobject image;
+    Herror err;
+    double start;
+    int i;
+
+    create_tuple_i(&delay, -1);
+    cam->grabbed = 0;
+    cam->errors = 0;
+    start = Now();
+    for(i = 0; i < cam->frames; i++)
+    {
+        if(cam->async)
+            err = T_grab_image_async(&image, cam->handle, delay);
+        else
+            err = T_grab_image(&image, cam->handle);
+        if(err != H_MSG_TRUE)
+        {
+            cam->errors++;
+            continue;
+        }
+        cam->latency[cam->grabbed++] = Now() - GetParam(cam->handle, "frame_timestamp");
+        clear_obj(image);
+    }
+    cam->elapsed = Now() - start;
+    destroy_tuple(delay);
+
+    return NULL;
+}
+
+static void Report(TBenchCamera * cam, int num_cameras, int mode, int verbose)
+{
+    static const double bucket_limit[NUM_BUCKETS] = {0.25, 0.5, 1, 2, 4, 8, 16, 32, 64, 128, 256, 1e30};
+    double * all, fps = 0.0, bytes;
+    int i, j, n = 0, errors = 0, received = 0, dropped = 0, timeouts = 0, bucket[NUM_BUCKETS];
+
+    all = (double *)malloc(sizeof(double) * num_cameras * cam[0].frames);
+    for(i = 0; i < num_cameras; i++)
+    {
+        memcpy(all + n, cam[i].latency, sizeof(double) * cam[i].grabbed);
+        n += cam[i].grabbed;
+        errors += cam[i].errors;
+        if(cam[i].elapsed > 0.0)
+            fps += cam[i].grabbed * 1000.0 / cam[i].elapsed;
+        received += (int)GetParam(cam[i].handle, "frames_received");
+        dropped += (int)GetParam(cam[i].handle, "frames_dropped");
+        timeouts += (int)GetParam(cam[i].handle, "grab_timeouts");
+    }
+    qsort(all, n, sizeof(double), CompareDouble);
+    bytes = (double)modelist[mode][0] * modelist[mode][1];
+
+    printf("%4dx%-4d %4d %9.1f %9.1f", modelist[mode][0], modelist[mode][1], num_cameras, fps / num_cameras, fps * bytes / 1e6);
+    if(n > 0)
+        printf(" %8.2f %8.2f %8.2f %8.2f", all[n / 2], all[n * 9 / 10], all[n * 99 / 100], all[n - 1]);
+    else
+        printf(" %8s %8s %8s %8s", "-", "-", "-", "-");
+    printf(" %8d %7d %7d %7d\n", received, dropped, timeouts, errors);
+
+    if(verbose && n > 0)
+    {
+        memset(bucket, 0, sizeof(bucket));
+        for(i = 0, j = 0; i < n; i++)
+        {
+            while(all[i] >= bucket_limit[j])
+                j++;
+            bucket[j]++;
+        }
+        for(j = 0; j < NUM_BUCKETS; j++)
+        {
+            if(!bucket[j])
+                continue;
+            if(j == NUM_BUCKETS - 1)
+                printf("    >= %6.2f ms: %6d\n", bucket_limit[j - 1], bucket[j]);
+            else
+                printf("    <  %6.2f ms: %6d\n", bucket_limit[j], bucket[j]);
+        }
+    }
+
+    free(all);
+}
+
+static void Usage(const char * name)
+{
+    fprintf(stderr, "usage: %s [-f frames] [-c cameras] [-b buffer_count] [-m mode] [-a] [-v]\n", name);
+    fprintf(stderr, "  -f  frames grabbed per camera and mode (default 300)\n");
+    fprintf(stderr, "  -c  number of cameras grabbed in parallel (default 1)\n");
+    fprintf(stderr, "  -b  buffer_count of each camera (default: interface default)\n");
+    fprintf(stderr, "  -m  only benchmark this mode index (default: all modes)\n");
+    fprintf(stderr, "  -a  grab asynchronously with grab_image_async\n");
+    fprintf(stderr, "  -v  print latency histograms\n");
+}
+
+int main(int argc, char ** argv)
+{
+    TBenchCamera cam[MAX_CAMERAS];
+    pthread_t thread[MAX_CAMERAS];
+    int opt, i, mode, frames = 300, num_cameras = 1, buffers = 0, only_mode = -1, async = 0, verbose = 0;
+    Herror err;
+
+    while((opt = getopt(argc, argv, "f:c:b:m:avh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'c':
+                num_cameras = atoi(optarg);
+                break;
+            case 'b':
+                buffers = atoi(optarg);
+                break;
+            case 'm':
+                only_mode = atoi(optarg);
+                break;
+            case 'a':
+                async = 1;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                Usage(argv[0]);
+                return 1;
+        }
+    }
+    if(frames < 1 || num_cameras < 1 || num_cameras > MAX_CAMERAS || only_mode >= NUM_MODES)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-9s %4s %9s %9s %8s %8s %8s %8s %8s %7s %7s %7s\n",
+           "mode", "cams", "fps/cam", "MB/s", "p50 ms", "p90 ms", "p99 ms", "max ms", "recv", "drop", "tmo", "err");
+
+    for(mode = 0; mode < NUM_MODES; mode++)
+    {
+        if(only_mode >= 0 && mode != only_mode)
+            continue;
+
+        for(i = 0; i < num_cameras; i++)
+        {
+            cam[i].frames = frames;
+            cam[i].async = async;
+            cam[i].latency = (double *)malloc(sizeof(double) * frames);
+            if((err = OpenCamera(&cam[i], i, mode, buffers)) != H_MSG_TRUE)
+                break;
+        }
+        if(i < num_cameras)
+        {
+            if(err != H_ERR_FGPARV)
+                fprintf(stderr, "%dx%d: opening camera %d failed (error %d)\n", modelist[mode][0], modelist[mode][1], i, (int)err);
+            free(cam[i].latency);
+            while(--i >= 0)
+            {
+                T_close_framegrabber(cam[i].handle);
+                destroy_tuple(cam[i].handle);
+                free(cam[i].latency);
+            }
+            continue;
+        }
+
+        for(i = 0; i < num_cameras; i++)
+            pthread_create(&thread[i], NULL, GrabThread, &cam[i]);
+        for(i = 0; i < num_cameras; i++)
+            pthread_join(thread[i], NULL);
+
+        Report(cam, num_cameras, mode, verbose);
+
+        for(i = 0; i < num_cameras; i++)
+        {
+            T_close_framegrabber(cam[i].handle);
+            destroy_tuple(cam[i].handle);
+            free(cam[i].latency);
+        }
+    }
+
+    return 0;
+}
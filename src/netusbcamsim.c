@@ -0,0 +1,610 @@
+/** \file netusbcamsim.c
+ * \brief Simulated NET iCube camera library.
+ *
+ * Implements the subset of the NETUSBCAM API used by the acquisition
+ * interface, generating synthetic frames from one thread per camera. Build
+ * it as a drop-in libNETUSBCAM.so ("make sim") and put it first on the
+ * library path to run the interface without hardware. The simulation is
+ * configured through environment variables read by NETUSBCAM_Init:
+ *
+ *   NETUSBCAM_SIM_CAMERAS   number of cameras (default 1)
+ *   NETUSBCAM_SIM_MODE      initial resolution mode (default 8)
+ *   NETUSBCAM_SIM_FPS       frame (or hardware trigger) rate (default 30)
+ *   NETUSBCAM_SIM_JITTER    uniform timing jitter in milliseconds (default 0)
+ *   NETUSBCAM_SIM_BURST     frames delivered back-to-back, at the same
+ *                           average rate (default 1)
+ *   NETUSBCAM_SIM_BITS      bits per pixel: 8, 10 or 12 (default 8)
+ *   NETUSBCAM_SIM_PACKED    pack 10 and 12 bit pixels into whole bytes
+ *                           (1, default) or send 16-bit words (0)
+ *
+ * The first four bytes of every frame hold its frame counter (little
+ * endian), so consumers can check ordering and drops.
+ */
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "netusbcamextra.h"
+#include <NETUSBCAM_API.h>
+
+#define SIM_MAX_CAMERAS 16
+#define SIM_NUM_MODES 9
+#define SIM_NUM_REGS 64
+
+static int sim_modelist[SIM_NUM_MODES][2] = {
+    {320, 240},
+    {640, 480},
+    {752, 480},
+    {800, 600},
+    {1024, 768},
+    {1280, 1024},
+    {1600, 1200},
+    {2048, 1536},
+    {2592, 1944}
+};
+
+/* Register ranges: minimum, maximum, default, auto capable               */
+static const int sim_registers[][5] = {
+    {REG_BRIGHTNESS, 0, 255, 128, 0},
+    {REG_CONTRAST, 0, 255, 128, 0},
+    {REG_GAMMA, 1, 100, 10, 0},
+    {REG_FLIPPED_V, 0, 1, 0, 0},
+    {REG_FLIPPED_H, 0, 1, 0, 0},
+    {REG_WHITE_BALANCE, 0, 1, 0, 1},
+    {REG_EXPOSURE_TIME, 1, 10000, 200, 1},
+    {REG_EXPOSURE_TARGET, 0, 255, 128, 0},
+    {REG_RED, 0, 255, 64, 0},
+    {REG_GREEN, 0, 255, 64, 0},
+    {REG_BLUE, 0, 255, 64, 0},
+    {REG_BLACKLEVEL, 0, 255, 0, 0},
+    {REG_GAIN, 0, 255, 32, 1},
+    {REG_COLOR, 0, 1, 0, 0},
+    {REG_PLL, 0, 100, 48, 0},
+    {REG_STROBE_LENGTH, 0, 10000, 0, 0},
+    {REG_STROBE_DELAY, 0, 10000, 0, 0},
+    {REG_TRIGGER_DELAY, 0, 10000, 0, 0},
+    {REG_SATURATION, 0, 255, 128, 0},
+    {REG_COLOR_MACHINE, 0, 1, 0, 0},
+    {REG_TRIGGER_INVERT, 0, 1, 0, 0},
+    {REG_MEASURE_FIELD_AE, 0, 3, 0, 0},
+    {REG_SHUTTER, 0, 1, 0, 0},
+    {REG_DEFECT_COR, 0, 1, 0, 0}
+};
+
+#define SIM_NUM_REGISTERS (int)(sizeof(sim_registers) / sizeof(sim_registers[0]))
+
+typedef struct
+{
+    int open;
+    int running;
+    int mode;
+    int width, height, col, row;
+    int trigger;
+    int pending;
+    int dirty;
+    unsigned int frame;
+    unsigned int seed;
+    unsigned long reg[SIM_NUM_REGS];
+    int reg_auto[SIM_NUM_REGS];
+    int (* callback)(void *, unsigned int, void *);
+    void * context;
+    unsigned char * pattern;
+    unsigned char * image;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} TSimCamera;
+
+static TSimCamera sim_camera[SIM_MAX_CAMERAS];
+static int sim_num_cameras = 0;
+static double sim_fps = 30.0;
+static double sim_jitter = 0.0;
+static int sim_burst = 1;
+static int sim_bits = 8;
+static int sim_packed = 1;
+static int sim_mode = SIM_NUM_MODES - 1;
+
+static int EnvInt(const char * name, int def)
+{
+    char * s = getenv(name);
+
+    return s ? atoi(s) : def;
+}
+
+static double EnvDouble(const char * name, double def)
+{
+    char * s = getenv(name);
+
+    return s ? atof(s) : def;
+}
+
+static const int * FindRegister(int type)
+{
+    int i;
+
+    for(i = 0; i < SIM_NUM_REGISTERS; i++)
+        if(sim_registers[i][0] == type)
+            return sim_registers[i];
+
+    return NULL;
+}
+
+static void AddTime(struct timespec * ts, double msec)
+{
+    long long nsec = (long long)(msec * 1000000.0);
+
+    nsec += ts->tv_nsec;
+    ts->tv_sec += nsec / 1000000000LL;
+    nsec %= 1000000000LL;
+    if(nsec < 0)
+    {
+        nsec += 1000000000LL;
+        ts->tv_sec--;
+    }
+    ts->tv_nsec = (long)nsec;
+}
+
+/* Build the synthetic scene (a diagonal gradient scaled by exposure and
+ * gain) with 256 spare pixels, so that frames can scroll through it.     */
+static int MakePattern(TSimCamera * cam)
+{
+    int i, v, size = cam->width * cam->height + 256;
+    long long num, den;
+    void * ptr;
+
+    ptr = realloc(cam->pattern, size);
+    if(!ptr)
+        return -1;
+    cam->pattern = (unsigned char *)ptr;
+    ptr = realloc(cam->image, 2 * size);
+    if(!ptr)
+        return -1;
+    cam->image = (unsigned char *)ptr;
+
+    num = 255LL * cam->reg[REG_EXPOSURE_TIME] * cam->reg[REG_GAIN];
+    den = (long long)(cam->width + cam->height) * FindRegister(REG_EXPOSURE_TIME)[3] * FindRegister(REG_GAIN)[3];
+    for(i = 0; i < size; i++)
+    {
+        v = (int)(((i % cam->width) + (i / cam->width)) * num / den) + (int)cam->reg[REG_BLACKLEVEL];
+        cam->pattern[i] = (unsigned char)(v > 255 ? 255 : v);
+    }
+    cam->dirty = 0;
+
+    return 0;
+}
+
+/* Convert count 8-bit scene pixels to the raw format configured by
+ * NETUSBCAM_SIM_BITS and NETUSBCAM_SIM_PACKED, filling the extra low bits
+ * from the pixel position. Returns the frame size in bytes.              */
+static unsigned int PackFrame(unsigned char * out, const unsigned char * in, unsigned int count)
+{
+    unsigned int i, v[4];
+    int j, extra = sim_bits - 8;
+
+    if(extra <= 0)
+    {
+        memcpy(out, in, count);
+        return count;
+    }
+    if(!sim_packed)
+    {
+        for(i = 0; i < count; i++)
+        {
+            v[0] = (in[i] << extra) | (i & ((1 << extra) - 1));
+            out[2 * i] = v[0] & 0xff;
+            out[2 * i + 1] = v[0] >> 8;
+        }
+        return 2 * count;
+    }
+
+    /* upper eight bits of each pixel, then the lower bits of the group */
+    if(sim_bits == 10)
+    {
+        for(i = 0; i + 4 <= count; i += 4, out += 5)
+        {
+            out[4] = 0;
+            for(j = 0; j < 4; j++)
+            {
+                v[j] = (in[i + j] << 2) | ((i + j) & 3);
+                out[j] = v[j] >> 2;
+                out[4] |= (v[j] & 3) << (2 * j);
+            }
+        }
+        return count / 4 * 5;
+    }
+    for(i = 0; i + 2 <= count; i += 2, out += 3)
+    {
+        v[0] = (in[i] << 4) | (i & 15);
+        v[1] = (in[i + 1] << 4) | ((i + 1) & 15);
+        out[0] = v[0] >> 4;
+        out[1] = v[1] >> 4;
+        out[2] = (v[0] & 15) | ((v[1] & 15) << 4);
+    }
+    return count / 2 * 3;
+}
+
+static void EmitFrame(TSimCamera * cam)
+{
+    unsigned int size;
+
+    if(cam->dirty)
+        MakePattern(cam);
+    size = PackFrame(cam->image, cam->pattern + (cam->frame & 0xff), cam->width * cam->height);
+    if(size >= 4)
+    {
+        cam->image[0] = cam->frame & 0xff;
+        cam->image[1] = (cam->frame >> 8) & 0xff;
+        cam->image[2] = (cam->frame >> 16) & 0xff;
+        cam->image[3] = (cam->frame >> 24) & 0xff;
+    }
+    cam->frame++;
+    if(cam->callback)
+        cam->callback(cam->image, size, cam->context);
+}
+
+static void * CameraThread(void * arg)
+{
+    TSimCamera * cam = (TSimCamera *)arg;
+    struct timespec next, due;
+    double period = 1000.0 / sim_fps;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    pthread_mutex_lock(&cam->mutex);
+    while(cam->running)
+    {
+        if(cam->trigger == TRIG_SW_START)
+        {
+            /* software trigger: one frame, one readout period after each trigger */
+            if(!cam->pending)
+            {
+                pthread_cond_wait(&cam->cond, &cam->mutex);
+                continue;
+            }
+            cam->pending--;
+            pthread_mutex_unlock(&cam->mutex);
+            clock_gettime(CLOCK_MONOTONIC, &due);
+            AddTime(&due, period);
+            while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0);
+            EmitFrame(cam);
+            clock_gettime(CLOCK_MONOTONIC, &next);
+            pthread_mutex_lock(&cam->mutex);
+            continue;
+        }
+
+        /* free running or hardware triggered at the configured rate */
+        AddTime(&next, period * sim_burst);
+        due = next;
+        if(sim_jitter > 0.0)
+            AddTime(&due, sim_jitter * (2.0 * rand_r(&cam->seed) / RAND_MAX - 1.0));
+        pthread_mutex_unlock(&cam->mutex);
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0);
+        for(i = 0; i < sim_burst && cam->running; i++)
+            EmitFrame(cam);
+        pthread_mutex_lock(&cam->mutex);
+    }
+    pthread_mutex_unlock(&cam->mutex);
+
+    return NULL;
+}
+
+static TSimCamera * GetCamera(int nCamIndex)
+{
+    if(nCamIndex < 0 || nCamIndex >= sim_num_cameras)
+        return NULL;
+
+    return &sim_camera[nCamIndex];
+}
+
+int NETUSBCAM_Init()
+{
+    int i, j;
+
+    sim_num_cameras = EnvInt("NETUSBCAM_SIM_CAMERAS", 1);
+    if(sim_num_cameras > SIM_MAX_CAMERAS)
+        sim_num_cameras = SIM_MAX_CAMERAS;
+    sim_mode = EnvInt("NETUSBCAM_SIM_MODE", SIM_NUM_MODES - 1);
+    if(sim_mode < 0 || sim_mode >= SIM_NUM_MODES)
+        sim_mode = SIM_NUM_MODES - 1;
+    sim_fps = EnvDouble("NETUSBCAM_SIM_FPS", 30.0);
+    if(sim_fps <= 0.0)
+        sim_fps = 30.0;
+    sim_jitter = EnvDouble("NETUSBCAM_SIM_JITTER", 0.0);
+    sim_burst = EnvInt("NETUSBCAM_SIM_BURST", 1);
+    if(sim_burst < 1)
+        sim_burst = 1;
+    sim_bits = EnvInt("NETUSBCAM_SIM_BITS", 8);
+    if(sim_bits != 10 && sim_bits != 12)
+        sim_bits = 8;
+    sim_packed = EnvInt("NETUSBCAM_SIM_PACKED", 1);
+
+    for(i = 0; i < sim_num_cameras; i++)
+    {
+        TSimCamera * cam = &sim_camera[i];
+
+        if(cam->open)
+            continue;
+        memset(cam, 0, sizeof(TSimCamera));
+        cam->trigger = TRIG_STOP;
+        cam->seed = i + 1;
+        for(j = 0; j < SIM_NUM_REGISTERS; j++)
+            cam->reg[sim_registers[j][0]] = sim_registers[j][3];
+        pthread_mutex_init(&cam->mutex, NULL);
+        pthread_cond_init(&cam->cond, NULL);
+    }
+
+    return sim_num_cameras;
+}
+
+int NETUSBCAM_Open(int nCamIndex)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || cam->open)
+        return -1;
+    cam->mode = sim_mode;
+    cam->width = sim_modelist[cam->mode][0];
+    cam->height = sim_modelist[cam->mode][1];
+    cam->col = cam->row = 0;
+    if(MakePattern(cam) != 0)
+        return -1;
+    cam->open = 1;
+
+    return 0;
+}
+
+int NETUSBCAM_Close(int nCamIndex)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || !cam->open)
+        return -1;
+    NETUSBCAM_Stop(nCamIndex);
+    free(cam->pattern);
+    free(cam->image);
+    cam->pattern = cam->image = NULL;
+    cam->open = 0;
+
+    return 0;
+}
+
+int NETUSBCAM_Start(int nCamIndex)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || !cam->open)
+        return -1;
+    if(cam->running)
+        return 0;
+    cam->running = 1;
+    cam->pending = 0;
+    if(pthread_create(&cam->thread, NULL, CameraThread, cam) != 0)
+    {
+        cam->running = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+int NETUSBCAM_Stop(int nCamIndex)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || !cam->open)
+        return -1;
+    if(!cam->running)
+        return 0;
+    pthread_mutex_lock(&cam->mutex);
+    cam->running = 0;
+    pthread_cond_signal(&cam->cond);
+    pthread_mutex_unlock(&cam->mutex);
+    pthread_join(cam->thread, NULL);
+
+    return 0;
+}
+
+int NETUSBCAM_SetCallback(int nCamIndex, int nMode, int (* pCallbackFunc)(void * buffer, unsigned int buffersize, void * context), void * pCBContext)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || nMode != CALLBACK_RAW)
+        return -1;
+    pthread_mutex_lock(&cam->mutex);
+    cam->callback = pCallbackFunc;
+    cam->context = pCBContext;
+    pthread_mutex_unlock(&cam->mutex);
+
+    return 0;
+}
+
+int NETUSBCAM_SetTrigger(int nCamIndex, int nMode)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam)
+        return -1;
+    pthread_mutex_lock(&cam->mutex);
+    if(nMode == TRIG_SW_DO)
+    {
+        if(cam->trigger == TRIG_SW_START)
+            cam->pending++;
+    }
+    else
+    {
+        cam->trigger = nMode;
+        cam->pending = 0;
+    }
+    pthread_cond_signal(&cam->cond);
+    pthread_mutex_unlock(&cam->mutex);
+
+    return 0;
+}
+
+int NETUSBCAM_GetModeList(int nCamIndex, unsigned int * nLength, unsigned int * pList)
+{
+    unsigned int i;
+
+    if(!GetCamera(nCamIndex))
+        return -1;
+    for(i = 0; i < SIM_NUM_MODES && i < *nLength; i++)
+        pList[i] = i;
+    *nLength = i;
+
+    return 0;
+}
+
+int NETUSBCAM_SetMode(int nCamIndex, unsigned int nMode)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || cam->running || nMode >= SIM_NUM_MODES)
+        return -1;
+    cam->mode = nMode;
+    cam->width = sim_modelist[nMode][0];
+    cam->height = sim_modelist[nMode][1];
+    cam->col = cam->row = 0;
+
+    return MakePattern(cam);
+}
+
+int NETUSBCAM_GetMode(int nCamIndex, unsigned int * nMode)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam)
+        return -1;
+    *nMode = cam->mode;
+
+    return 0;
+}
+
+int NETUSBCAM_SetResolution(int nCamIndex, int nXRes, int nYRes, int nXPos, int nYPos)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || cam->running)
+        return -1;
+    if(nXRes < 1 || nYRes < 1 || nXPos < 0 || nYPos < 0
+       || nXPos + nXRes > sim_modelist[cam->mode][0] || nYPos + nYRes > sim_modelist[cam->mode][1])
+        return -1;
+    cam->width = nXRes;
+    cam->height = nYRes;
+    cam->col = nXPos;
+    cam->row = nYPos;
+
+    return MakePattern(cam);
+}
+
+int NETUSBCAM_GetResolution(int nCamIndex, int * nXRes, int * nYRes, int * nXPos, int * nYPos)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam)
+        return -1;
+    *nXRes = cam->width;
+    *nYRes = cam->height;
+    *nXPos = cam->col;
+    *nYPos = cam->row;
+
+    return 0;
+}
+
+int NETUSBCAM_GetResolutionRange(int nCamIndex, ROI_RANGE_PROPERTY * property)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam)
+        return -1;
+    memset(property, 0, sizeof(ROI_RANGE_PROPERTY));
+    property->nXMin = 0;
+    property->nYMin = 0;
+    property->nXMax = sim_modelist[cam->mode][0];
+    property->nYMax = sim_modelist[cam->mode][1];
+
+    return 0;
+}
+
+int NETUSBCAM_SetCamParameter(int nCamIndex, int Type, unsigned long Value)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+    const int * reg = FindRegister(Type);
+
+    if(!cam || !reg || (long)Value < reg[1] || (long)Value > reg[2])
+        return -1;
+    cam->reg[Type] = Value;
+
+    /* the scene is rebuilt before the next frame */
+    if(Type == REG_EXPOSURE_TIME || Type == REG_GAIN || Type == REG_BLACKLEVEL)
+    {
+        if(cam->running)
+            cam->dirty = 1;
+        else
+            return MakePattern(cam);
+    }
+
+    return 0;
+}
+
+int NETUSBCAM_GetCamParameter(int nCamIndex, int Type, unsigned long * Value)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam || !FindRegister(Type))
+        return -1;
+    *Value = cam->reg[Type];
+
+    return 0;
+}
+
+int NETUSBCAM_GetCamParameterRange(int nCamIndex, int Type, PARAM_PROPERTY * property)
+{
+    const int * reg = FindRegister(Type);
+
+    if(!GetCamera(nCamIndex) || !reg)
+        return -1;
+    memset(property, 0, sizeof(PARAM_PROPERTY));
+    property->nMin = reg[1];
+    property->nMax = reg[2];
+    property->nDef = reg[3];
+
+    return 0;
+}
+
+int NETUSBCAM_SetParamAuto(int nCamIndex, int Type, int bAuto)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+    const int * reg = FindRegister(Type);
+
+    if(!cam || !reg || !reg[4])
+        return -1;
+    cam->reg_auto[Type] = bAuto ? 1 : 0;
+
+    return 0;
+}
+
+int NETUSBCAM_GetParamAuto(int nCamIndex, int Type, int * bAuto)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+    const int * reg = FindRegister(Type);
+
+    if(!cam || !reg || !reg[4])
+        return -1;
+    *bAuto = cam->reg_auto[Type];
+
+    return 0;
+}
+
+int NETUSBCAM_GetExposure(int nCamIndex, float * fExpTime)
+{
+    TSimCamera * cam = GetCamera(nCamIndex);
+
+    if(!cam)
+        return -1;
+    *fExpTime = cam->reg[REG_EXPOSURE_TIME] / 20.0f;
+
+    return 0;
+}
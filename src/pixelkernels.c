@@ -0,0 +1,1357 @@
+/** \file pixelkernels.c
+ * \brief Pixel processing kernels for the NET iCube acquisition interface.
+ */
+
+#include <string.h>
+
+#include "pixelkernels.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
+enum {
+    COLOR_RED = 0,
+    COLOR_GREEN,
+    COLOR_BLUE
+};
+
+/* Interpolation sources for one output channel at one pixel: the pixel
+ * itself, its horizontal, vertical or diagonal neighbours, or the cross
+ * of horizontal and vertical neighbours (green at red/blue pixels).      */
+enum {
+    SRC_CENTER = 0,
+    SRC_HORIZONTAL,
+    SRC_VERTICAL,
+    SRC_DIAGONAL,
+    SRC_CROSS,
+    NUM_SRC
+};
+
+/* Colors of the 2x2 Bayer cell for each pattern.                         */
+static const INT bayer_cell[4][2][2] = {
+    {{COLOR_RED, COLOR_GREEN}, {COLOR_GREEN, COLOR_BLUE}},
+    {{COLOR_GREEN, COLOR_RED}, {COLOR_BLUE, COLOR_GREEN}},
+    {{COLOR_BLUE, COLOR_GREEN}, {COLOR_GREEN, COLOR_RED}},
+    {{COLOR_GREEN, COLOR_BLUE}, {COLOR_RED, COLOR_GREEN}}
+};
+
+#define AVG(A, B) (((A) + (B) + 1) >> 1)
+
+static INT Source(INT pattern, INT y, INT x, INT color)
+{
+    INT c = bayer_cell[pattern][y & 1][x & 1];
+
+    if(c == color)
+        return SRC_CENTER;
+    if(color == COLOR_GREEN)
+        return SRC_CROSS;
+    if(c == COLOR_GREEN)
+        return bayer_cell[pattern][y & 1][(x + 1) & 1] == color ? SRC_HORIZONTAL : SRC_VERTICAL;
+    return SRC_DIAGONAL;
+}
+
+/* Fetch a raw pixel, mirroring coordinates at the border (which keeps
+ * the Bayer phase intact).                                               */
+static INT Fetch(const HBYTE * raw, INT width, INT height, INT y, INT x)
+{
+    if(x < 0)
+        x = -x;
+    if(x >= width)
+        x = 2 * (width - 1) - x;
+    if(y < 0)
+        y = -y;
+    if(y >= height)
+        y = 2 * (height - 1) - y;
+    if(x < 0)
+        x = 0;
+    if(y < 0)
+        y = 0;
+
+    return raw[y * width + x];
+}
+
+#define P(DY, DX) Fetch(raw, width, height, y + (DY), x + (DX))
+
+static HBYTE PixelBilinear(const HBYTE * raw, INT width, INT height, INT y, INT x, INT src)
+{
+    switch(src)
+    {
+        case SRC_HORIZONTAL:
+            return AVG(P(0, -1), P(0, 1));
+        case SRC_VERTICAL:
+            return AVG(P(-1, 0), P(1, 0));
+        case SRC_DIAGONAL:
+            return AVG(AVG(P(-1, -1), P(-1, 1)), AVG(P(1, -1), P(1, 1)));
+        case SRC_CROSS:
+            return AVG(AVG(P(0, -1), P(0, 1)), AVG(P(-1, 0), P(1, 0)));
+        default:
+            return P(0, 0);
+    }
+}
+
+/* Gradient-corrected linear interpolation (Malvar, He and Cutler), with
+ * all filter coefficients scaled by 16.                                  */
+static HBYTE PixelGradient(const HBYTE * raw, INT width, INT height, INT y, INT x, INT src)
+{
+    INT c, v;
+
+    c = P(0, 0);
+    switch(src)
+    {
+        case SRC_HORIZONTAL:
+            v = 10 * c + 8 * (P(0, -1) + P(0, 1)) - 2 * (P(0, -2) + P(0, 2))
+                - 2 * (P(-1, -1) + P(-1, 1) + P(1, -1) + P(1, 1)) + P(-2, 0) + P(2, 0);
+            break;
+        case SRC_VERTICAL:
+            v = 10 * c + 8 * (P(-1, 0) + P(1, 0)) - 2 * (P(-2, 0) + P(2, 0))
+                - 2 * (P(-1, -1) + P(-1, 1) + P(1, -1) + P(1, 1)) + P(0, -2) + P(0, 2);
+            break;
+        case SRC_DIAGONAL:
+            v = 12 * c + 4 * (P(-1, -1) + P(-1, 1) + P(1, -1) + P(1, 1))
+                - 3 * (P(-2, 0) + P(2, 0) + P(0, -2) + P(0, 2));
+            break;
+        case SRC_CROSS:
+            v = 8 * c + 4 * (P(-1, 0) + P(1, 0) + P(0, -1) + P(0, 1))
+                - 2 * (P(-2, 0) + P(2, 0) + P(0, -2) + P(0, 2));
+            break;
+        default:
+            return (HBYTE)c;
+    }
+
+    v = (v + 8) / 16;
+    return (HBYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+#undef P
+
+#ifdef __SSE2__
+
+static __m128i Select(__m128i odd_mask, __m128i even, __m128i odd)
+{
+    return _mm_or_si128(_mm_and_si128(odd_mask, odd), _mm_andnot_si128(odd_mask, even));
+}
+
+/* Bilinear interpolation of row y, 16 pixels at a time, starting at an
+ * even column x. Returns the first column left unprocessed.              */
+static INT RowBilinear(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3])
+{
+    const HBYTE * r0 = raw + (y - 1) * width;
+    const HBYTE * r1 = raw + y * width;
+    const HBYTE * r2 = raw + (y + 1) * width;
+    const __m128i odd_mask = _mm_set1_epi16((short)0xFF00);
+    __m128i v[NUM_SRC];
+    INT ch;
+
+    for(; x + 17 <= width; x += 16)
+    {
+        v[SRC_CENTER] = _mm_loadu_si128((const __m128i *)(r1 + x));
+        v[SRC_HORIZONTAL] = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r1 + x - 1)), _mm_loadu_si128((const __m128i *)(r1 + x + 1)));
+        v[SRC_VERTICAL] = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r0 + x)), _mm_loadu_si128((const __m128i *)(r2 + x)));
+        v[SRC_DIAGONAL] = _mm_avg_epu8(
+            _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r0 + x - 1)), _mm_loadu_si128((const __m128i *)(r0 + x + 1))),
+            _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r2 + x - 1)), _mm_loadu_si128((const __m128i *)(r2 + x + 1))));
+        v[SRC_CROSS] = _mm_avg_epu8(v[SRC_HORIZONTAL], v[SRC_VERTICAL]);
+
+        for(ch = 0; ch < 3; ch++)
+            _mm_storeu_si128((__m128i *)(out[ch] + x), Select(odd_mask, v[src[ch][0]], v[src[ch][1]]));
+    }
+
+    return x;
+}
+
+/* Gradient-corrected interpolation of row y, 8 pixels at a time, starting
+ * at an even column x. Returns the first column left unprocessed.        */
+static INT RowGradient(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3])
+{
+    const HBYTE * r0 = raw + (y - 2) * width;
+    const HBYTE * r1 = raw + (y - 1) * width;
+    const HBYTE * r2 = raw + y * width;
+    const HBYTE * r3 = raw + (y + 1) * width;
+    const HBYTE * r4 = raw + (y + 2) * width;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i odd_mask = _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    const __m128i round = _mm_set1_epi16(8);
+    __m128i c, n, s, e, w, nn, ss, ee, ww, diag, far, v[NUM_SRC];
+    INT ch;
+
+#define LOAD(R, DX) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)((R) + x + (DX))), zero)
+    for(; x + 10 <= width; x += 8)
+    {
+        c = LOAD(r2, 0);
+        n = LOAD(r1, 0);
+        s = LOAD(r3, 0);
+        e = LOAD(r2, 1);
+        w = LOAD(r2, -1);
+        nn = LOAD(r0, 0);
+        ss = LOAD(r4, 0);
+        ee = LOAD(r2, 2);
+        ww = LOAD(r2, -2);
+        diag = _mm_add_epi16(_mm_add_epi16(LOAD(r1, -1), LOAD(r1, 1)), _mm_add_epi16(LOAD(r3, -1), LOAD(r3, 1)));
+        nn = _mm_add_epi16(nn, ss);
+        ee = _mm_add_epi16(ee, ww);
+        n = _mm_add_epi16(n, s);
+        e = _mm_add_epi16(e, w);
+        far = _mm_add_epi16(nn, ee);
+
+        /* 8c + 4(n + s + e + w) - 2(nn + ss + ee + ww) */
+        v[SRC_CROSS] = _mm_sub_epi16(_mm_add_epi16(_mm_slli_epi16(c, 3), _mm_slli_epi16(_mm_add_epi16(n, e), 2)), _mm_slli_epi16(far, 1));
+        /* 10c - 2 diag */
+        s = _mm_sub_epi16(_mm_add_epi16(_mm_slli_epi16(c, 3), _mm_slli_epi16(c, 1)), _mm_slli_epi16(diag, 1));
+        /* + 8(e + w) - 2(ee + ww) + (nn + ss) */
+        v[SRC_HORIZONTAL] = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(s, _mm_slli_epi16(e, 3)), _mm_slli_epi16(ee, 1)), nn);
+        /* + 8(n + s) - 2(nn + ss) + (ee + ww) */
+        v[SRC_VERTICAL] = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(s, _mm_slli_epi16(n, 3)), _mm_slli_epi16(nn, 1)), ee);
+        /* 12c + 4 diag - 3(nn + ss + ee + ww) */
+        v[SRC_DIAGONAL] = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(c, 3), _mm_slli_epi16(c, 2)), _mm_slli_epi16(diag, 2)),
+                                        _mm_add_epi16(_mm_slli_epi16(far, 1), far));
+        v[SRC_CENTER] = _mm_slli_epi16(c, 4);
+
+        for(ch = 0; ch < 3; ch++)
+        {
+            s = _mm_srai_epi16(_mm_add_epi16(Select(odd_mask, v[src[ch][0]], v[src[ch][1]]), round), 4);
+            _mm_storel_epi64((__m128i *)(out[ch] + x), _mm_packus_epi16(s, s));
+        }
+    }
+#undef LOAD
+
+    return x;
+}
+
+/* AVX2 versions of the demosaicing rows, twice as wide.                  */
+
+__attribute__((target("avx2")))
+static __m256i SelectAVX2(__m256i odd_mask, __m256i even, __m256i odd)
+{
+    return _mm256_blendv_epi8(even, odd, odd_mask);
+}
+
+__attribute__((target("avx2")))
+static INT RowBilinearAVX2(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3])
+{
+    const HBYTE * r0 = raw + (y - 1) * width;
+    const HBYTE * r1 = raw + y * width;
+    const HBYTE * r2 = raw + (y + 1) * width;
+    const __m256i odd_mask = _mm256_set1_epi16((short)0xFF00);
+    __m256i v[NUM_SRC];
+    INT ch;
+
+#define LOAD(R, DX) _mm256_loadu_si256((const __m256i *)((R) + x + (DX)))
+    for(; x + 33 <= width; x += 32)
+    {
+        v[SRC_CENTER] = LOAD(r1, 0);
+        v[SRC_HORIZONTAL] = _mm256_avg_epu8(LOAD(r1, -1), LOAD(r1, 1));
+        v[SRC_VERTICAL] = _mm256_avg_epu8(LOAD(r0, 0), LOAD(r2, 0));
+        v[SRC_DIAGONAL] = _mm256_avg_epu8(_mm256_avg_epu8(LOAD(r0, -1), LOAD(r0, 1)), _mm256_avg_epu8(LOAD(r2, -1), LOAD(r2, 1)));
+        v[SRC_CROSS] = _mm256_avg_epu8(v[SRC_HORIZONTAL], v[SRC_VERTICAL]);
+
+        for(ch = 0; ch < 3; ch++)
+            _mm256_storeu_si256((__m256i *)(out[ch] + x), SelectAVX2(odd_mask, v[src[ch][0]], v[src[ch][1]]));
+    }
+#undef LOAD
+
+    return x;
+}
+
+__attribute__((target("avx2")))
+static INT RowGradientAVX2(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3])
+{
+    const HBYTE * r0 = raw + (y - 2) * width;
+    const HBYTE * r1 = raw + (y - 1) * width;
+    const HBYTE * r2 = raw + y * width;
+    const HBYTE * r3 = raw + (y + 1) * width;
+    const HBYTE * r4 = raw + (y + 2) * width;
+    const __m256i odd_mask = _mm256_set1_epi32((int)0xFFFF0000);
+    const __m256i round = _mm256_set1_epi16(8);
+    __m256i c, n, s, e, w, nn, ss, ee, ww, diag, far, v[NUM_SRC];
+    INT ch;
+
+#define LOAD(R, DX) _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)((R) + x + (DX))))
+    for(; x + 18 <= width; x += 16)
+    {
+        c = LOAD(r2, 0);
+        n = LOAD(r1, 0);
+        s = LOAD(r3, 0);
+        e = LOAD(r2, 1);
+        w = LOAD(r2, -1);
+        nn = LOAD(r0, 0);
+        ss = LOAD(r4, 0);
+        ee = LOAD(r2, 2);
+        ww = LOAD(r2, -2);
+        diag = _mm256_add_epi16(_mm256_add_epi16(LOAD(r1, -1), LOAD(r1, 1)), _mm256_add_epi16(LOAD(r3, -1), LOAD(r3, 1)));
+        nn = _mm256_add_epi16(nn, ss);
+        ee = _mm256_add_epi16(ee, ww);
+        n = _mm256_add_epi16(n, s);
+        e = _mm256_add_epi16(e, w);
+        far = _mm256_add_epi16(nn, ee);
+
+        /* the same sums as RowGradient */
+        v[SRC_CROSS] = _mm256_sub_epi16(_mm256_add_epi16(_mm256_slli_epi16(c, 3), _mm256_slli_epi16(_mm256_add_epi16(n, e), 2)), _mm256_slli_epi16(far, 1));
+        s = _mm256_sub_epi16(_mm256_add_epi16(_mm256_slli_epi16(c, 3), _mm256_slli_epi16(c, 1)), _mm256_slli_epi16(diag, 1));
+        v[SRC_HORIZONTAL] = _mm256_add_epi16(_mm256_sub_epi16(_mm256_add_epi16(s, _mm256_slli_epi16(e, 3)), _mm256_slli_epi16(ee, 1)), nn);
+        v[SRC_VERTICAL] = _mm256_add_epi16(_mm256_sub_epi16(_mm256_add_epi16(s, _mm256_slli_epi16(n, 3)), _mm256_slli_epi16(nn, 1)), ee);
+        v[SRC_DIAGONAL] = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(c, 3), _mm256_slli_epi16(c, 2)), _mm256_slli_epi16(diag, 2)),
+                                           _mm256_add_epi16(_mm256_slli_epi16(far, 1), far));
+        v[SRC_CENTER] = _mm256_slli_epi16(c, 4);
+
+        for(ch = 0; ch < 3; ch++)
+        {
+            s = _mm256_srai_epi16(_mm256_add_epi16(SelectAVX2(odd_mask, v[src[ch][0]], v[src[ch][1]]), round), 4);
+            _mm_storeu_si128((__m128i *)(out[ch] + x), _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+        }
+    }
+#undef LOAD
+
+    return x;
+}
+
+#endif /* __SSE2__ */
+
+/* Columns reduced per pass, bounding the row sum buffer.                 */
+#define REDUCE_CHUNK 256
+
+#ifdef __SSE2__
+
+/* Add 16 8-bit pixels at a time to 16-bit sums. Returns the first pixel
+ * left unprocessed.                                                      */
+static INT AccumulateRow(const HBYTE * in, INT count, UINT2 * sum)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(sum + i), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(sum + i)), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i *)(sum + i + 8), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(sum + i + 8)), _mm_unpackhi_epi8(v, zero)));
+    }
+
+    return i;
+}
+
+/* Sum pairs of 16-bit lanes.                                             */
+static __m128i AddPairs(__m128i a, __m128i b)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+
+    return _mm_packs_epi32(_mm_madd_epi16(a, ones), _mm_madd_epi16(b, ones));
+}
+
+/* Turn column sums of factor rows into rounded block averages, 16 output
+ * pixels at a time.                                                      */
+static INT AverageRow(const UINT2 * sum, INT count, INT factor, HBYTE * out)
+{
+    const __m128i round = _mm_set1_epi16(factor * factor / 2);
+    const __m128i shift = _mm_cvtsi32_si128(factor == 2 ? 2 : 4);
+    const __m128i * s;
+    __m128i a, b;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        s = (const __m128i *)(sum + i * factor);
+        a = AddPairs(_mm_loadu_si128(s), _mm_loadu_si128(s + 1));
+        b = AddPairs(_mm_loadu_si128(s + 2), _mm_loadu_si128(s + 3));
+        if(factor == 4)
+        {
+            a = AddPairs(a, b);
+            b = AddPairs(AddPairs(_mm_loadu_si128(s + 4), _mm_loadu_si128(s + 5)),
+                         AddPairs(_mm_loadu_si128(s + 6), _mm_loadu_si128(s + 7)));
+        }
+        a = _mm_srl_epi16(_mm_add_epi16(a, round), shift);
+        b = _mm_srl_epi16(_mm_add_epi16(b, round), shift);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+/* Keep the first pixel of every factor pixels, 16 output pixels at a
+ * time.                                                                  */
+static INT DecimateRow(const HBYTE * in, INT count, INT factor, HBYTE * out)
+{
+    const __m128i word = _mm_set1_epi16(0x00FF);
+    const __m128i dword = _mm_set1_epi32(0x000000FF);
+    __m128i a, b;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        if(factor == 2)
+        {
+            a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 2 * i)), word);
+            b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 2 * i + 16)), word);
+        }
+        else
+        {
+            a = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 4 * i)), dword),
+                                _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 4 * i + 16)), dword));
+            b = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 4 * i + 32)), dword),
+                                _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + 4 * i + 48)), dword));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+/* AVX2 versions of the reduction rows, 32 output pixels at a time. The
+ * packs work within each 128-bit lane, so their results are put back in
+ * order by a permutation.                                                */
+
+__attribute__((target("avx2")))
+static __m256i AddPairsAVX2(__m256i a, __m256i b)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_madd_epi16(a, ones), _mm256_madd_epi16(b, ones)), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static INT AverageRowAVX2(const UINT2 * sum, INT count, INT factor, HBYTE * out)
+{
+    const __m256i round = _mm256_set1_epi16(factor * factor / 2);
+    const __m128i shift = _mm_cvtsi32_si128(factor == 2 ? 2 : 4);
+    const __m256i * s;
+    __m256i a, b;
+    INT i;
+
+    for(i = 0; i + 32 <= count; i += 32)
+    {
+        s = (const __m256i *)(sum + i * factor);
+        a = AddPairsAVX2(_mm256_loadu_si256(s), _mm256_loadu_si256(s + 1));
+        b = AddPairsAVX2(_mm256_loadu_si256(s + 2), _mm256_loadu_si256(s + 3));
+        if(factor == 4)
+        {
+            a = AddPairsAVX2(a, b);
+            b = AddPairsAVX2(AddPairsAVX2(_mm256_loadu_si256(s + 4), _mm256_loadu_si256(s + 5)),
+                             AddPairsAVX2(_mm256_loadu_si256(s + 6), _mm256_loadu_si256(s + 7)));
+        }
+        a = _mm256_srl_epi16(_mm256_add_epi16(a, round), shift);
+        b = _mm256_srl_epi16(_mm256_add_epi16(b, round), shift);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT DecimateRowAVX2(const HBYTE * in, INT count, INT factor, HBYTE * out)
+{
+    const __m256i word = _mm256_set1_epi16(0x00FF);
+    const __m256i dword = _mm256_set1_epi32(0x000000FF);
+    __m256i a, b;
+    INT i;
+
+#define LOAD(K) _mm256_loadu_si256((const __m256i *)(in + factor * i + 32 * (K)))
+    for(i = 0; i + 32 <= count; i += 32)
+    {
+        if(factor == 2)
+        {
+            a = _mm256_and_si256(LOAD(0), word);
+            b = _mm256_and_si256(LOAD(1), word);
+        }
+        else
+        {
+            a = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(LOAD(0), dword), _mm256_and_si256(LOAD(1), dword)), 0xD8);
+            b = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(LOAD(2), dword), _mm256_and_si256(LOAD(3), dword)), 0xD8);
+        }
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+#undef LOAD
+
+    return i;
+}
+
+#endif /* __SSE2__ */
+
+UINT RawSize(INT format, UINT count)
+{
+    switch(format)
+    {
+        case RAW_10_PACKED:
+            return count / 4 * 5;
+        case RAW_12_PACKED:
+            return count / 2 * 3;
+        case RAW_16:
+            return count * 2;
+        default:
+            return count;
+    }
+}
+
+INT RawFormat(UINT size, UINT count)
+{
+    INT format;
+
+    for(format = RAW_8; format <= RAW_16; format++)
+        if(size == RawSize(format, count))
+            return format;
+
+    return -1;
+}
+
+INT RawBits(INT format, INT depth)
+{
+    switch(format)
+    {
+        case RAW_10_PACKED:
+            return 10;
+        case RAW_12_PACKED:
+            return 12;
+        case RAW_16:
+            return depth;
+        default:
+            return 8;
+    }
+}
+
+/* Raw pixel i of a frame; packed formats store the upper eight bits of
+ * each pixel in whole bytes, followed by the lower bits of the group.    */
+static INT RawPixel(const HBYTE * raw, INT format, INT i)
+{
+    const HBYTE * g;
+
+    switch(format)
+    {
+        case RAW_10_PACKED:
+            g = raw + (i >> 2) * 5;
+            return (g[i & 3] << 2) | ((g[4] >> (2 * (i & 3))) & 3);
+        case RAW_12_PACKED:
+            g = raw + (i >> 1) * 3;
+            return (g[i & 1] << 4) | ((g[2] >> (4 * (i & 1))) & 15);
+        case RAW_16:
+            return raw[2 * i] | (raw[2 * i + 1] << 8);
+        default:
+            return raw[i];
+    }
+}
+
+#ifdef __SSE2__
+
+/* 8-bit pixels to 16-bit, 16 pixels at a time. Returns the first pixel
+ * left unprocessed.                                                      */
+static INT WidenByte(const HBYTE * raw, INT count, INT left, UINT2 * out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    __m128i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *)(raw + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sll_epi16(_mm_unpacklo_epi8(v, zero), sl));
+        _mm_storeu_si128((__m128i *)(out + i + 8), _mm_sll_epi16(_mm_unpackhi_epi8(v, zero), sl));
+    }
+
+    return i;
+}
+
+/* 16-bit pixels, masked to their significant bits and shifted, 8 pixels
+ * at a time.                                                             */
+static INT ShiftWord(const HBYTE * raw, INT count, INT mask, INT left, INT right, UINT2 * out)
+{
+    const __m128i m = _mm_set1_epi16((short)mask);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    __m128i v;
+    INT i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(raw + 2 * i)), m);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_srl_epi16(_mm_sll_epi16(v, sl), sr));
+    }
+
+    return i;
+}
+
+/* 16-bit pixels to their upper eight significant bits, 16 pixels at a
+ * time.                                                                  */
+static INT NarrowWord(const HBYTE * raw, INT count, INT mask, INT right, HBYTE * out)
+{
+    const __m128i m = _mm_set1_epi16((short)mask);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    __m128i a, b;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        a = _mm_srl_epi16(_mm_and_si128(_mm_loadu_si128((const __m128i *)(raw + 2 * i)), m), sr);
+        b = _mm_srl_epi16(_mm_and_si128(_mm_loadu_si128((const __m128i *)(raw + 2 * i + 16)), m), sr);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+/* Add 16-bit pixels to 16-bit sums, 16 pixels at a time.                */
+static INT AddWord(const UINT2 * in, INT count, UINT2 * sum)
+{
+    __m128i * s;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        s = (__m128i *)(sum + i);
+        _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_loadu_si128((const __m128i *)(in + i))));
+        _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_loadu_si128((const __m128i *)(in + i + 8))));
+    }
+
+    return i;
+}
+
+/* Rounded quotients of four 32-bit sums. Single precision is exact here:
+ * the sums are below 2^24, and a quotient that is not an integer is at
+ * least 1 / frames away from one.                                        */
+static __m128i Quotient(__m128i x, __m128i round, __m128 frames)
+{
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(x, round)), frames));
+}
+
+/* Averages of 16-bit sums of frames as 8-bit pixels, 16 pixels at a
+ * time.                                                                  */
+static INT DivideByte(const UINT2 * sum, INT count, INT frames, HBYTE * out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(frames / 2);
+    const __m128 f = _mm_set1_ps((float)frames);
+    __m128i a, b;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        a = _mm_loadu_si128((const __m128i *)(sum + i));
+        b = _mm_loadu_si128((const __m128i *)(sum + i + 8));
+        a = _mm_packs_epi32(Quotient(_mm_unpacklo_epi16(a, zero), round, f), Quotient(_mm_unpackhi_epi16(a, zero), round, f));
+        b = _mm_packs_epi32(Quotient(_mm_unpacklo_epi16(b, zero), round, f), Quotient(_mm_unpackhi_epi16(b, zero), round, f));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+/* Averages of 16-bit sums of frames, shifted left first, as 16-bit
+ * pixels, 8 pixels at a time. SSE2 only packs signed, so the quotients
+ * are biased into the signed range and back.                             */
+static INT DivideWord(const UINT2 * sum, INT count, INT frames, INT shift, UINT2 * out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(frames / 2);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    const __m128i sl = _mm_cvtsi32_si128(shift);
+    const __m128 f = _mm_set1_ps((float)frames);
+    __m128i v, a, b;
+    INT i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        v = _mm_loadu_si128((const __m128i *)(sum + i));
+        a = _mm_sub_epi32(Quotient(_mm_sll_epi32(_mm_unpacklo_epi16(v, zero), sl), round, f), bias32);
+        b = _mm_sub_epi32(Quotient(_mm_sll_epi32(_mm_unpackhi_epi16(v, zero), sl), round, f), bias32);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(_mm_packs_epi32(a, b), bias16));
+    }
+
+    return i;
+}
+
+/* Flat-field correction of 8 16-bit pixels: the dark level subtracted
+ * (saturating at zero), times the gain in fixed point, rounded by the
+ * upper bit of the low half of the product. The pixels are scaled up by
+ * 2^(16 - FLAT_FIELD_SHIFT) first, which 12-bit pixels still fit.          */
+static __m128i FlatField(__m128i x, const UINT2 * dark, const UINT2 * gain)
+{
+    __m128i g = _mm_loadu_si128((const __m128i *)gain);
+
+    x = _mm_slli_epi16(_mm_subs_epu16(x, _mm_loadu_si128((const __m128i *)dark)), 16 - FLAT_FIELD_SHIFT);
+
+    return _mm_add_epi16(_mm_mulhi_epu16(x, g), _mm_srli_epi16(_mm_mullo_epi16(x, g), 15));
+}
+
+/* Flat-field correction of 8-bit pixels in place, 16 pixels at a time.  */
+static INT FlatFieldByteSSE2(HBYTE * pix, const UINT2 * dark, const UINT2 * gain, INT count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v, a, b;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *)(pix + i));
+        a = FlatField(_mm_unpacklo_epi8(v, zero), dark + i, gain + i);
+        b = FlatField(_mm_unpackhi_epi8(v, zero), dark + i + 8, gain + i + 8);
+        _mm_storeu_si128((__m128i *)(pix + i), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+/* Flat-field correction of 16-bit pixels in place, clipped to top, 8
+ * pixels at a time. SSE2 has no unsigned minimum, which a saturating
+ * subtraction stands in for.                                             */
+static INT FlatFieldWordSSE2(UINT2 * pix, const UINT2 * dark, const UINT2 * gain, INT count, INT top)
+{
+    const __m128i t = _mm_set1_epi16((short)top);
+    __m128i v;
+    INT i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        v = FlatField(_mm_loadu_si128((const __m128i *)(pix + i)), dark + i, gain + i);
+        _mm_storeu_si128((__m128i *)(pix + i), _mm_sub_epi16(v, _mm_subs_epu16(v, t)));
+    }
+
+    return i;
+}
+
+/* The packed formats need a byte shuffle, which SSE2 lacks; these kernels
+ * are compiled for SSSE3 and only used when the CPU supports it.         */
+
+/* 10-bit packed pixels to 16-bit, 8 pixels (two groups) at a time.       */
+__attribute__((target("ssse3")))
+static INT Unpack10(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out)
+{
+    const __m128i order = _mm_setr_epi8(4, 0, 4, 1, 4, 2, 4, 3, 9, 5, 9, 6, 9, 7, 9, 8);
+    const __m128i scale = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    UINT size = RawSize(RAW_10_PACKED, count);
+    __m128i w, hi, lo;
+    INT i;
+
+    /* each lane holds the upper bits of its pixel above the group's low
+       bits byte, which is scaled to bring the pixel's two bits to 6..7 */
+    for(i = 0; i + 8 <= count && (UINT)(i / 4 * 5 + 16) <= size; i += 8)
+    {
+        w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(raw + i / 4 * 5)), order);
+        hi = _mm_and_si128(_mm_srli_epi16(w, 6), _mm_set1_epi16(0x03FC));
+        lo = _mm_mullo_epi16(_mm_and_si128(w, _mm_set1_epi16(0x00FF)), scale);
+        lo = _mm_and_si128(_mm_srli_epi16(lo, 6), _mm_set1_epi16(0x0003));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_srl_epi16(_mm_sll_epi16(_mm_or_si128(hi, lo), sl), sr));
+    }
+
+    return i;
+}
+
+/* 12-bit packed pixels to 16-bit, 8 pixels (four groups) at a time.      */
+__attribute__((target("ssse3")))
+static INT Unpack12(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out)
+{
+    const __m128i order = _mm_setr_epi8(2, 0, 2, 1, 5, 3, 5, 4, 8, 6, 8, 7, 11, 9, 11, 10);
+    const __m128i odd_mask = _mm_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+    const __m128i nibble = _mm_set1_epi16(0x000F);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    UINT size = RawSize(RAW_12_PACKED, count);
+    __m128i w, hi, lo;
+    INT i;
+
+    /* each lane holds the upper bits of its pixel above the group's low
+       bits byte, whose lower nibble belongs to even and upper nibble to
+       odd pixels */
+    for(i = 0; i + 8 <= count && (UINT)(i / 2 * 3 + 16) <= size; i += 8)
+    {
+        w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(raw + i / 2 * 3)), order);
+        hi = _mm_and_si128(_mm_srli_epi16(w, 4), _mm_set1_epi16(0x0FF0));
+        lo = Select(odd_mask, _mm_and_si128(w, nibble), _mm_and_si128(_mm_srli_epi16(w, 4), nibble));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_srl_epi16(_mm_sll_epi16(_mm_or_si128(hi, lo), sl), sr));
+    }
+
+    return i;
+}
+
+/* AVX2 versions of the unpacking kernels, twice as wide. The byte
+ * shuffle works within each 128-bit lane, so the packed kernels load the
+ * two lanes separately.                                                  */
+
+__attribute__((target("avx2")))
+static INT WidenByteAVX2(const HBYTE * raw, INT count, INT left, UINT2 * out)
+{
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    __m256i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(raw + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_sll_epi16(v, sl));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT ShiftWordAVX2(const HBYTE * raw, INT count, INT mask, INT left, INT right, UINT2 * out)
+{
+    const __m256i m = _mm256_set1_epi16((short)mask);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    __m256i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(raw + 2 * i)), m);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_srl_epi16(_mm256_sll_epi16(v, sl), sr));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT NarrowWordAVX2(const HBYTE * raw, INT count, INT mask, INT right, HBYTE * out)
+{
+    const __m256i m = _mm256_set1_epi16((short)mask);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    __m256i a, b;
+    INT i;
+
+    /* the pack interleaves the lanes of a and b, which the permutation
+       puts back in order */
+    for(i = 0; i + 32 <= count; i += 32)
+    {
+        a = _mm256_srl_epi16(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(raw + 2 * i)), m), sr);
+        b = _mm256_srl_epi16(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(raw + 2 * i + 32)), m), sr);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+
+    return i;
+}
+
+/* Two unaligned 128-bit loads into the lanes of one register.           */
+__attribute__((target("avx2")))
+static __m256i LoadLanes(const HBYTE * low, const HBYTE * high)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)low)),
+                                   _mm_loadu_si128((const __m128i *)high), 1);
+}
+
+/* 10-bit packed pixels to 16-bit, 16 pixels (four groups) at a time.     */
+__attribute__((target("avx2")))
+static INT Unpack10AVX2(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out)
+{
+    const __m256i order = _mm256_setr_epi8(4, 0, 4, 1, 4, 2, 4, 3, 9, 5, 9, 6, 9, 7, 9, 8,
+                                           4, 0, 4, 1, 4, 2, 4, 3, 9, 5, 9, 6, 9, 7, 9, 8);
+    const __m256i scale = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    UINT size = RawSize(RAW_10_PACKED, count);
+    const HBYTE * in;
+    __m256i w, hi, lo;
+    INT i;
+
+    for(i = 0; i + 16 <= count && (UINT)(i / 4 * 5 + 26) <= size; i += 16)
+    {
+        in = raw + i / 4 * 5;
+        w = _mm256_shuffle_epi8(LoadLanes(in, in + 10), order);
+        hi = _mm256_and_si256(_mm256_srli_epi16(w, 6), _mm256_set1_epi16(0x03FC));
+        lo = _mm256_mullo_epi16(_mm256_and_si256(w, _mm256_set1_epi16(0x00FF)), scale);
+        lo = _mm256_and_si256(_mm256_srli_epi16(lo, 6), _mm256_set1_epi16(0x0003));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_srl_epi16(_mm256_sll_epi16(_mm256_or_si256(hi, lo), sl), sr));
+    }
+
+    return i;
+}
+
+/* 12-bit packed pixels to 16-bit, 16 pixels (eight groups) at a time.    */
+__attribute__((target("avx2")))
+static INT Unpack12AVX2(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out)
+{
+    const __m256i order = _mm256_setr_epi8(2, 0, 2, 1, 5, 3, 5, 4, 8, 6, 8, 7, 11, 9, 11, 10,
+                                           2, 0, 2, 1, 5, 3, 5, 4, 8, 6, 8, 7, 11, 9, 11, 10);
+    const __m256i nibble = _mm256_set1_epi16(0x000F);
+    const __m128i sl = _mm_cvtsi32_si128(left);
+    const __m128i sr = _mm_cvtsi32_si128(right);
+    UINT size = RawSize(RAW_12_PACKED, count);
+    const HBYTE * in;
+    __m256i w, hi, lo;
+    INT i;
+
+    for(i = 0; i + 16 <= count && (UINT)(i / 2 * 3 + 28) <= size; i += 16)
+    {
+        in = raw + i / 2 * 3;
+        w = _mm256_shuffle_epi8(LoadLanes(in, in + 12), order);
+        hi = _mm256_and_si256(_mm256_srli_epi16(w, 4), _mm256_set1_epi16(0x0FF0));
+        lo = _mm256_blend_epi16(_mm256_and_si256(w, nibble), _mm256_and_si256(_mm256_srli_epi16(w, 4), nibble), 0xAA);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_srl_epi16(_mm256_sll_epi16(_mm256_or_si256(hi, lo), sl), sr));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT AddByteAVX2(const HBYTE * in, INT count, UINT2 * sum)
+{
+    __m256i * s;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        s = (__m256i *)(sum + i);
+        _mm256_storeu_si256(s, _mm256_add_epi16(_mm256_loadu_si256(s), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + i)))));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT AddWordAVX2(const UINT2 * in, INT count, UINT2 * sum)
+{
+    __m256i * s;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        s = (__m256i *)(sum + i);
+        _mm256_storeu_si256(s, _mm256_add_epi16(_mm256_loadu_si256(s), _mm256_loadu_si256((const __m256i *)(in + i))));
+    }
+
+    return i;
+}
+
+/* Rounded quotients of eight 16-bit sums, widened and shifted left.      */
+__attribute__((target("avx2")))
+static __m256i QuotientAVX2(const UINT2 * sum, __m128i sl, __m256i round, __m256 frames)
+{
+    __m256i x = _mm256_sll_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)sum)), sl);
+
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(x, round)), frames));
+}
+
+__attribute__((target("avx2")))
+static INT DivideByteAVX2(const UINT2 * sum, INT count, INT frames, HBYTE * out)
+{
+    const __m256i round = _mm256_set1_epi32(frames / 2);
+    const __m256 f = _mm256_set1_ps((float)frames);
+    const __m128i sl = _mm_setzero_si128();
+    __m256i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm256_permute4x64_epi64(_mm256_packs_epi32(QuotientAVX2(sum + i, sl, round, f), QuotientAVX2(sum + i + 8, sl, round, f)), 0xD8);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT DivideWordAVX2(const UINT2 * sum, INT count, INT frames, INT shift, UINT2 * out)
+{
+    const __m256i round = _mm256_set1_epi32(frames / 2);
+    const __m256 f = _mm256_set1_ps((float)frames);
+    const __m128i sl = _mm_cvtsi32_si128(shift);
+    __m256i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = _mm256_packus_epi32(QuotientAVX2(sum + i, sl, round, f), QuotientAVX2(sum + i + 8, sl, round, f));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(v, 0xD8));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static __m256i FlatFieldAVX2(__m256i x, const UINT2 * dark, const UINT2 * gain)
+{
+    __m256i g = _mm256_loadu_si256((const __m256i *)gain);
+
+    x = _mm256_slli_epi16(_mm256_subs_epu16(x, _mm256_loadu_si256((const __m256i *)dark)), 16 - FLAT_FIELD_SHIFT);
+
+    return _mm256_add_epi16(_mm256_mulhi_epu16(x, g), _mm256_srli_epi16(_mm256_mullo_epi16(x, g), 15));
+}
+
+__attribute__((target("avx2")))
+static INT FlatFieldByteAVX2(HBYTE * pix, const UINT2 * dark, const UINT2 * gain, INT count)
+{
+    __m256i a, b;
+    INT i;
+
+    for(i = 0; i + 32 <= count; i += 32)
+    {
+        a = FlatFieldAVX2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(pix + i))), dark + i, gain + i);
+        b = FlatFieldAVX2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(pix + i + 16))), dark + i + 16, gain + i + 16);
+        _mm256_storeu_si256((__m256i *)(pix + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static INT FlatFieldWordAVX2(UINT2 * pix, const UINT2 * dark, const UINT2 * gain, INT count, INT top)
+{
+    const __m256i t = _mm256_set1_epi16((short)top);
+    __m256i v;
+    INT i;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        v = FlatFieldAVX2(_mm256_loadu_si256((const __m256i *)(pix + i)), dark + i, gain + i);
+        _mm256_storeu_si256((__m256i *)(pix + i), _mm256_min_epu16(v, t));
+    }
+
+    return i;
+}
+
+#endif /* __SSE2__ */
+
+/* Kernels of the instruction set chosen by SelectKernels; each processes
+ * a prefix of its pixels and returns its length, leaving the rest to the
+ * scalar loop. Null kernels process nothing.                             */
+static struct
+{
+    INT level;
+    INT (*widen_byte)(const HBYTE * raw, INT count, INT left, UINT2 * out);
+    INT (*shift_word)(const HBYTE * raw, INT count, INT mask, INT left, INT right, UINT2 * out);
+    INT (*narrow_word)(const HBYTE * raw, INT count, INT mask, INT right, HBYTE * out);
+    INT (*unpack10)(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out);
+    INT (*unpack12)(const HBYTE * raw, INT count, INT left, INT right, UINT2 * out);
+    INT (*add_byte)(const HBYTE * in, INT count, UINT2 * sum);
+    INT (*add_word)(const UINT2 * in, INT count, UINT2 * sum);
+    INT (*divide_byte)(const UINT2 * sum, INT count, INT frames, HBYTE * out);
+    INT (*divide_word)(const UINT2 * sum, INT count, INT frames, INT shift, UINT2 * out);
+    INT (*flat_field_byte)(HBYTE * pix, const UINT2 * dark, const UINT2 * gain, INT count);
+    INT (*flat_field_word)(UINT2 * pix, const UINT2 * dark, const UINT2 * gain, INT count, INT top);
+    INT (*row_bilinear)(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3]);
+    INT (*row_gradient)(const HBYTE * raw, INT width, INT y, INT x, INT src[3][2], HBYTE * out[3]);
+    INT (*average_row)(const UINT2 * sum, INT count, INT factor, HBYTE * out);
+    INT (*decimate_row)(const HBYTE * in, INT count, INT factor, HBYTE * out);
+} kernels = {
+#ifdef __SSE2__
+    KERNELS_SSE2, &WidenByte, &ShiftWord, &NarrowWord, NULL, NULL,
+    &AccumulateRow, &AddWord, &DivideByte, &DivideWord,
+    &FlatFieldByteSSE2, &FlatFieldWordSSE2,
+    &RowBilinear, &RowGradient, &AverageRow, &DecimateRow
+#else
+    KERNELS_GENERIC, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL,
+    NULL, NULL,
+    NULL, NULL, NULL, NULL
+#endif
+};
+
+INT SelectKernels(void)
+{
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        kernels.level = KERNELS_AVX2;
+        kernels.widen_byte = &WidenByteAVX2;
+        kernels.shift_word = &ShiftWordAVX2;
+        kernels.narrow_word = &NarrowWordAVX2;
+        kernels.unpack10 = &Unpack10AVX2;
+        kernels.unpack12 = &Unpack12AVX2;
+        kernels.add_byte = &AddByteAVX2;
+        kernels.add_word = &AddWordAVX2;
+        kernels.divide_byte = &DivideByteAVX2;
+        kernels.divide_word = &DivideWordAVX2;
+        kernels.flat_field_byte = &FlatFieldByteAVX2;
+        kernels.flat_field_word = &FlatFieldWordAVX2;
+        kernels.row_bilinear = &RowBilinearAVX2;
+        kernels.row_gradient = &RowGradientAVX2;
+        kernels.average_row = &AverageRowAVX2;
+        kernels.decimate_row = &DecimateRowAVX2;
+    }
+    else if(__builtin_cpu_supports("ssse3"))
+    {
+        kernels.level = KERNELS_SSSE3;
+        kernels.unpack10 = &Unpack10;
+        kernels.unpack12 = &Unpack12;
+    }
+#endif
+
+    return kernels.level;
+}
+
+void Demosaic(const HBYTE * raw, INT width, INT height, INT pattern, INT method, HBYTE * red, HBYTE * green, HBYTE * blue)
+{
+    HBYTE * out[3], * row_out[3];
+    INT src[2][3][2];
+    INT x, y, ch, row;
+    HBYTE (* pixel)(const HBYTE *, INT, INT, INT, INT, INT);
+
+    out[COLOR_RED] = red;
+    out[COLOR_GREEN] = green;
+    out[COLOR_BLUE] = blue;
+    pixel = method == DEMOSAIC_GRADIENT ? PixelGradient : PixelBilinear;
+
+    for(y = 0; y < 2; y++)
+        for(ch = 0; ch < 3; ch++)
+            for(x = 0; x < 2; x++)
+                src[y][ch][x] = Source(pattern, y, x, ch);
+
+    for(y = 0; y < height; y++)
+    {
+        row = y * width;
+        x = 0;
+        if(y >= 2 && y < height - 2)
+        {
+            /* interior: borders of two pixels are left to the scalar path */
+            for(; x < 2 && x < width; x++)
+                for(ch = 0; ch < 3; ch++)
+                    out[ch][row + x] = pixel(raw, width, height, y, x, src[y & 1][ch][x & 1]);
+            for(ch = 0; ch < 3; ch++)
+                row_out[ch] = out[ch] + row;
+            if(method == DEMOSAIC_GRADIENT && kernels.row_gradient)
+                x = kernels.row_gradient(raw, width, y, x, src[y & 1], row_out);
+            else if(method == DEMOSAIC_BILINEAR && kernels.row_bilinear)
+                x = kernels.row_bilinear(raw, width, y, x, src[y & 1], row_out);
+        }
+        for(; x < width; x++)
+            for(ch = 0; ch < 3; ch++)
+                out[ch][row + x] = pixel(raw, width, height, y, x, src[y & 1][ch][x & 1]);
+    }
+}
+
+void Reduce(const HBYTE * in, INT width, INT height, INT factor, INT method, HBYTE * out)
+{
+    UINT2 sum[REDUCE_CHUNK];
+    INT x, y, k, i, n, chunk, rw = width / factor, rh = height / factor;
+    const HBYTE * row;
+    HBYTE * dst;
+
+    for(y = 0; y < rh; y++)
+    {
+        dst = out + y * rw;
+        row = in + y * factor * width;
+        if(method == REDUCE_DECIMATE)
+        {
+            x = 0;
+            if((factor == 2 || factor == 4) && kernels.decimate_row)
+                x = kernels.decimate_row(row, rw, factor, dst);
+            for(; x < rw; x++)
+                dst[x] = row[x * factor];
+            continue;
+        }
+
+        /* sum the block rows column by column, then across each block */
+        for(x = 0; x < rw; x += chunk)
+        {
+            chunk = rw - x < REDUCE_CHUNK / factor ? rw - x : REDUCE_CHUNK / factor;
+            n = chunk * factor;
+            memset(sum, 0, n * sizeof(UINT2));
+            for(k = 0; k < factor; k++)
+                AccumulateByte(row + k * width + x * factor, n, sum);
+            i = 0;
+            if((factor == 2 || factor == 4) && kernels.average_row)
+                i = kernels.average_row(sum, chunk, factor, dst + x);
+            for(; i < chunk; i++)
+            {
+                n = 0;
+                for(k = 0; k < factor; k++)
+                    n += sum[i * factor + k];
+                dst[x + i] = (HBYTE)((n + factor * factor / 2) / (factor * factor));
+            }
+        }
+    }
+}
+
+void UnpackByte(const HBYTE * raw, INT format, INT count, INT depth, HBYTE * out)
+{
+    INT i = 0, right = RawBits(format, depth) - 8, mask = (1 << RawBits(format, depth)) - 1;
+
+    if(format == RAW_8)
+    {
+        memcpy(out, raw, count);
+        return;
+    }
+    if(format == RAW_16 && kernels.narrow_word)
+        i = kernels.narrow_word(raw, count, mask, right, out);
+    for(; i < count; i++)
+        out[i] = (HBYTE)((RawPixel(raw, format, i) & mask) >> right);
+}
+
+void UnpackWord(const HBYTE * raw, INT format, INT count, INT depth, UINT2 * out)
+{
+    INT i = 0, bits = RawBits(format, depth), mask = (1 << bits) - 1;
+    INT left = depth > bits ? depth - bits : 0, right = bits > depth ? bits - depth : 0;
+
+    if(format == RAW_8 && kernels.widen_byte)
+        i = kernels.widen_byte(raw, count, left, out);
+    else if(format == RAW_16 && kernels.shift_word)
+        i = kernels.shift_word(raw, count, mask, left, right, out);
+    else if(format == RAW_10_PACKED && kernels.unpack10)
+        i = kernels.unpack10(raw, count, left, right, out);
+    else if(format == RAW_12_PACKED && kernels.unpack12)
+        i = kernels.unpack12(raw, count, left, right, out);
+    for(; i < count; i++)
+        out[i] = (UINT2)(((RawPixel(raw, format, i) & mask) << left) >> right);
+}
+
+void AccumulateByte(const HBYTE * in, INT count, UINT2 * sum)
+{
+    INT i = 0;
+
+    if(kernels.add_byte)
+        i = kernels.add_byte(in, count, sum);
+    for(; i < count; i++)
+        sum[i] += in[i];
+}
+
+void AccumulateWord(const UINT2 * in, INT count, UINT2 * sum)
+{
+    INT i = 0;
+
+    if(kernels.add_word)
+        i = kernels.add_word(in, count, sum);
+    for(; i < count; i++)
+        sum[i] += in[i];
+}
+
+void AverageByte(const UINT2 * sum, INT count, INT frames, HBYTE * out)
+{
+    INT i = 0;
+
+    if(kernels.divide_byte)
+        i = kernels.divide_byte(sum, count, frames, out);
+    for(; i < count; i++)
+        out[i] = (HBYTE)((sum[i] + frames / 2) / frames);
+}
+
+void AverageWord(const UINT2 * sum, INT count, INT frames, INT shift, UINT2 * out)
+{
+    INT i = 0;
+
+    if(kernels.divide_word)
+        i = kernels.divide_word(sum, count, frames, shift, out);
+    for(; i < count; i++)
+        out[i] = (UINT2)((((UINT)sum[i] << shift) + frames / 2) / frames);
+}
+
+/* Scalar flat-field correction of one pixel, as the vector kernels do it. */
+static UINT FlatFieldPixel(UINT x, UINT dark, UINT gain)
+{
+    x = x > dark ? x - dark : 0;
+
+    return (x * gain + (1 << (FLAT_FIELD_SHIFT - 1))) >> FLAT_FIELD_SHIFT;
+}
+
+void FlatFieldByte(HBYTE * pix, const UINT2 * dark, const UINT2 * gain, INT count)
+{
+    INT i = 0;
+    UINT v;
+
+    if(kernels.flat_field_byte)
+        i = kernels.flat_field_byte(pix, dark, gain, count);
+    for(; i < count; i++)
+    {
+        v = FlatFieldPixel(pix[i], dark[i], gain[i]);
+        pix[i] = (HBYTE)(v < 255 ? v : 255);
+    }
+}
+
+void FlatFieldWord(UINT2 * pix, const UINT2 * dark, const UINT2 * gain, INT count, INT depth)
+{
+    INT i = 0, top = (1 << depth) - 1;
+    UINT v;
+
+    if(kernels.flat_field_word)
+        i = kernels.flat_field_word(pix, dark, gain, count, top);
+    for(; i < count; i++)
+    {
+        v = FlatFieldPixel(pix[i], dark[i], gain[i]);
+        pix[i] = (UINT2)(v < (UINT)top ? v : (UINT)top);
+    }
+}
+
+void LookupByte(HBYTE * pix, const HBYTE * lut, INT count)
+{
+    INT i;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        pix[i] = lut[pix[i]];
+        pix[i + 1] = lut[pix[i + 1]];
+        pix[i + 2] = lut[pix[i + 2]];
+        pix[i + 3] = lut[pix[i + 3]];
+    }
+    for(; i < count; i++)
+        pix[i] = lut[pix[i]];
+}
+
+void LookupWord(UINT2 * pix, const UINT2 * lut, INT count, INT depth)
+{
+    UINT mask = (1 << depth) - 1;
+    INT i;
+
+    for(i = 0; i < count; i++)
+        pix[i] = lut[pix[i] & mask];
+}
+
+void ClearStatistics(TPixelStatistics * stats, INT depth)
+{
+    stats->depth = depth < STATISTICS_DEPTH_MAX ? depth : STATISTICS_DEPTH_MAX;
+    stats->count = 0;
+    memset(stats->histogram, 0, sizeof(UINT) << stats->depth);
+}
+
+void StatisticsByte(const HBYTE * in, INT width, INT height, INT stride, TPixelStatistics * stats)
+{
+    UINT lanes[3][256];
+    UINT * hist = stats->histogram;
+    INT i, y;
+
+    /* consecutive pixels go to separate histograms, so that runs of equal
+       pixels do not wait on each other's increments */
+    memset(lanes, 0, sizeof(lanes));
+    for(y = 0; y < height; y++, in += stride)
+    {
+        for(i = 0; i + 4 <= width; i += 4)
+        {
+            hist[in[i]]++;
+            lanes[0][in[i + 1]]++;
+            lanes[1][in[i + 2]]++;
+            lanes[2][in[i + 3]]++;
+        }
+        for(; i < width; i++)
+            hist[in[i]]++;
+    }
+    for(i = 0; i < 256; i++)
+        hist[i] += lanes[0][i] + lanes[1][i] + lanes[2][i];
+    stats->count += width * height;
+}
+
+void StatisticsWord(const UINT2 * in, INT width, INT height, INT stride, TPixelStatistics * stats)
+{
+    UINT * hist = stats->histogram;
+    UINT mask = (1 << stats->depth) - 1;
+    INT i, y;
+
+    for(y = 0; y < height; y++, in += stride)
+        for(i = 0; i < width; i++)
+            hist[in[i] & mask]++;
+    stats->count += width * height;
+}
+
+HBOOL SummarizeStatistics(const TPixelStatistics * stats, double * mean, INT * lowest, INT * highest, UINT * saturated)
+{
+    INT i, top = (1 << stats->depth) - 1;
+    double sum = 0.0;
+
+    if(stats->count == 0)
+        return FALSE;
+
+    *lowest = -1;
+    for(i = 0; i <= top; i++)
+    {
+        if(!stats->histogram[i])
+            continue;
+        if(*lowest < 0)
+            *lowest = i;
+        *highest = i;
+        sum += (double)i * stats->histogram[i];
+    }
+    *mean = sum / stats->count;
+    *saturated = stats->histogram[top];
+
+    return TRUE;
+}
@@ -0,0 +1,141 @@
+/** \file pixelkernels.h
+ * \brief Pixel processing kernels for the NET iCube acquisition interface.
+ */
+
+#ifndef __PIXELKERNELS_H__
+#define __PIXELKERNELS_H__
+
+#include <Halcon.h>
+
+/* Instruction sets of the pixel kernels.                                 */
+enum {
+    KERNELS_GENERIC = 0,
+    KERNELS_SSE2,
+    KERNELS_SSSE3,
+    KERNELS_AVX2
+};
+
+/* Select the fastest kernels the CPU supports; until then, the kernels
+ * of the build's baseline instruction set are used. Returns the
+ * instruction set selected.                                              */
+extern INT SelectKernels(void);
+
+/* Bayer patterns, named after the colors of the first two pixels.        */
+enum {
+    BAYER_RG = 0,
+    BAYER_GR,
+    BAYER_BG,
+    BAYER_GB
+};
+
+/* Demosaicing methods.                                                   */
+enum {
+    DEMOSAIC_BILINEAR = 0,
+    DEMOSAIC_GRADIENT
+};
+
+/* Convert a raw Bayer frame to planar RGB.                               */
+extern void Demosaic(const HBYTE * raw, INT width, INT height, INT pattern, INT method, HBYTE * red, HBYTE * green, HBYTE * blue);
+
+/* Resolution reduction methods.                                          */
+enum {
+    REDUCE_AVERAGE = 0,
+    REDUCE_DECIMATE
+};
+
+/* Reduce an 8-bit frame by factor in both directions, averaging or
+ * subsampling factor x factor blocks. The output is width / factor by
+ * height / factor pixels; partial blocks at the border are dropped.      */
+extern void Reduce(const HBYTE * in, INT width, INT height, INT factor, INT method, HBYTE * out);
+
+/* Raw pixel formats delivered by the camera.                             */
+enum {
+    RAW_8 = 0,
+    RAW_10_PACKED,
+    RAW_12_PACKED,
+    RAW_16
+};
+
+/* Size in bytes of count raw pixels.                                     */
+extern UINT RawSize(INT format, UINT count);
+
+/* Raw format of a frame of count pixels, told apart by its size in bytes
+ * (-1 if it matches none).                                               */
+extern INT RawFormat(UINT size, UINT count);
+
+/* Significant bits of a raw format; RAW_16 pixels carry depth bits.      */
+extern INT RawBits(INT format, INT depth);
+
+/* Unpack count raw pixels to 8-bit pixels. RAW_16 pixels carry depth
+ * significant bits.                                                      */
+extern void UnpackByte(const HBYTE * raw, INT format, INT count, INT depth, HBYTE * out);
+
+/* Unpack count raw pixels to 16-bit pixels with depth significant bits,
+ * shifting formats of a different precision.                             */
+extern void UnpackWord(const HBYTE * raw, INT format, INT count, INT depth, UINT2 * out);
+
+/* Frames whose sum fits 16 bits at the deepest pixels the camera
+ * delivers (12 bits).                                                    */
+#define AVERAGE_FRAMES_MAX 16
+
+/* Add count 8-bit pixels to 16-bit sums.                                 */
+extern void AccumulateByte(const HBYTE * in, INT count, UINT2 * sum);
+
+/* Add count 16-bit pixels to 16-bit sums.                                */
+extern void AccumulateWord(const UINT2 * in, INT count, UINT2 * sum);
+
+/* Rounded averages of count sums of frames frames, as 8-bit pixels.      */
+extern void AverageByte(const UINT2 * sum, INT count, INT frames, HBYTE * out);
+
+/* Rounded averages of count sums of frames frames, as 16-bit pixels
+ * gaining shift bits of precision. The shifted sums must stay below
+ * 2^24 and their averages below 2^16.                                    */
+extern void AverageWord(const UINT2 * sum, INT count, INT frames, INT shift, UINT2 * out);
+
+/* Fraction bits of flat-field gains, which range up to 16.              */
+#define FLAT_FIELD_SHIFT 12
+
+/* Subtract the dark level from count 8-bit pixels in place and multiply
+ * them by their gain, rounding and clipping to 255.                      */
+extern void FlatFieldByte(HBYTE * pix, const UINT2 * dark, const UINT2 * gain, INT count);
+
+/* Subtract the dark level from count 16-bit pixels of depth significant
+ * bits (at most 12) in place and multiply them by their gain, rounding
+ * and clipping to the largest value of the depth.                        */
+extern void FlatFieldWord(UINT2 * pix, const UINT2 * dark, const UINT2 * gain, INT count, INT depth);
+
+/* Map count 8-bit pixels in place through a table of 256 entries.       */
+extern void LookupByte(HBYTE * pix, const HBYTE * lut, INT count);
+
+/* Map count 16-bit pixels in place through a table of 2^depth entries,
+ * by their depth significant bits.                                       */
+extern void LookupWord(UINT2 * pix, const UINT2 * lut, INT count, INT depth);
+
+/* Deepest pixels counted by the frame statistics.                        */
+#define STATISTICS_DEPTH_MAX 12
+
+/* Histogram of the pixels of a frame at their full depth, from which the
+ * other statistics are derived.                                          */
+typedef struct
+{
+    INT depth;
+    UINT count;
+    UINT histogram[1 << STATISTICS_DEPTH_MAX];
+} TPixelStatistics;
+
+/* Start statistics of pixels with depth significant bits.                */
+extern void ClearStatistics(TPixelStatistics * stats, INT depth);
+
+/* Count the 8-bit pixels of a width x height block whose rows are stride
+ * pixels apart.                                                          */
+extern void StatisticsByte(const HBYTE * in, INT width, INT height, INT stride, TPixelStatistics * stats);
+
+/* Count the 16-bit pixels of a width x height block whose rows are stride
+ * pixels apart.                                                          */
+extern void StatisticsWord(const UINT2 * in, INT width, INT height, INT stride, TPixelStatistics * stats);
+
+/* Mean, minimum and maximum of the pixels counted, and the number at the
+ * largest value of their depth. Returns FALSE if no pixel was counted.   */
+extern HBOOL SummarizeStatistics(const TPixelStatistics * stats, double * mean, INT * lowest, INT * highest, UINT * saturated);
+
+#endif /* __PIXELKERNELS_H__ */
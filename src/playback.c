@@ -0,0 +1,288 @@
+/** \file playback.c
+ * \brief Recording playback device for the NET iCube acquisition interface.
+ */
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "netusbcamextra.h"
+#include "playback.h"
+
+/* Longest sleep of the playback thread in milliseconds, bounding the time
+ * to notice a stop.                                                      */
+#define PLAYBACK_WAIT 50
+
+/* Interval of polling for room at the max timing in milliseconds.        */
+#define PLAYBACK_POLL 1
+
+#define ATOMIC_LOAD(X) __atomic_load_n(&(X), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(X, V) __atomic_store_n(&(X), (V), __ATOMIC_SEQ_CST)
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static struct timespec Milliseconds(double ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - ts.tv_sec * 1000.0) * 1000000.0);
+
+    return ts;
+}
+
+/* Sleep until due (monotonic milliseconds). Returns FALSE if playback was
+ * stopped meanwhile.                                                     */
+static HBOOL SleepUntil(TPlayback * pb, double due)
+{
+    struct timespec ts;
+    double left;
+
+    while(ATOMIC_LOAD(pb->running) && (left = due - Now()) > 0.0)
+    {
+        ts = Milliseconds(left < PLAYBACK_WAIT ? left : PLAYBACK_WAIT);
+        nanosleep(&ts, NULL);
+    }
+
+    return ATOMIC_LOAD(pb->running);
+}
+
+/* Wait for a software trigger not yet served. Returns FALSE if none came
+ * within PLAYBACK_WAIT milliseconds.                                     */
+static HBOOL WaitTrigger(TPlayback * pb, UINT served)
+{
+    struct timespec ts = Milliseconds(PLAYBACK_WAIT);
+    UINT triggers = ATOMIC_LOAD(pb->triggers);
+
+    if(triggers == served)
+    {
+        syscall(SYS_futex, &pb->triggers, FUTEX_WAIT_PRIVATE, triggers, &ts, NULL, 0);
+        triggers = ATOMIC_LOAD(pb->triggers);
+    }
+
+    return triggers != served;
+}
+
+static void * PlaybackThread(void * arg)
+{
+    TPlayback * pb = (TPlayback *)arg;
+    TRecordEntry * entry;
+    HBOOL rebase = TRUE;
+    double base = 0.0, base_time = 0.0, rate, due;
+    UINT n = 0, served = ATOMIC_LOAD(pb->triggers);
+
+    while(ATOMIC_LOAD(pb->running))
+    {
+        if(pb->next >= pb->count)
+        {
+            if(!ATOMIC_LOAD(pb->loop))
+            {
+                SleepUntil(pb, Now() + PLAYBACK_WAIT);
+                continue;
+            }
+            pb->next = 0;
+            rebase = TRUE;
+        }
+        entry = &pb->entry[pb->next];
+
+        if(ATOMIC_LOAD(pb->triggered))
+        {
+            /* one frame per trigger, as soon as it comes */
+            if(!WaitTrigger(pb, served))
+                continue;
+            served++;
+            rebase = TRUE;
+        }
+        else
+        {
+            /* triggers given while free running are not kept */
+            served = ATOMIC_LOAD(pb->triggers);
+            if(rebase)
+            {
+                base = Now();
+                base_time = entry->time;
+                n = 0;
+                rebase = FALSE;
+            }
+            __atomic_load(&pb->rate, &rate, __ATOMIC_RELAXED);
+            switch(ATOMIC_LOAD(pb->timing))
+            {
+                case PLAYBACK_RECORDED:
+                    due = base + (entry->time - base_time);
+                    break;
+                case PLAYBACK_FIXED:
+                    due = base + n * 1000.0 / rate;
+                    break;
+                default:
+                    /* as fast as the frames are taken, checking the
+                       trigger mode again while there is no room */
+                    if(pb->ready && !pb->ready(pb->context))
+                    {
+                        SleepUntil(pb, Now() + PLAYBACK_POLL);
+                        continue;
+                    }
+                    due = 0.0;
+            }
+            if(!SleepUntil(pb, due))
+                break;
+        }
+
+        pb->callback(pb->data + entry->offset, entry->length, pb->context);
+        pb->next++;
+        n++;
+        __atomic_add_fetch(&pb->played, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+/* Map a whole file read-only. Returns NULL on failure.                   */
+static void * MapFile(const char * filename, size_t * size)
+{
+    struct stat st;
+    void * ptr;
+    int fd;
+
+    if((fd = open(filename, O_RDONLY)) < 0)
+        return NULL;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return NULL;
+    *size = (size_t)st.st_size;
+
+    return ptr;
+}
+
+INT PlaybackOpen(TPlayback * pb, const char * filename)
+{
+    char index_name[RECORD_PATH_MAX + sizeof(RECORD_INDEX_SUFFIX)];
+    UINT i;
+
+    memset(pb, 0, sizeof(TPlayback));
+    pb->timing = PLAYBACK_RECORDED;
+    pb->rate = 30.0;
+    pb->loop = FALSE;
+    if(strlen(filename) >= RECORD_PATH_MAX)
+        return 1;
+    strcpy(index_name, filename);
+    strcat(index_name, RECORD_INDEX_SUFFIX);
+
+    pb->data = (HBYTE *)MapFile(filename, &pb->data_size);
+    pb->header = (TRecordHeader *)MapFile(index_name, &pb->index_size);
+    if(!pb->data || !pb->header || pb->index_size < sizeof(TRecordHeader)
+       || memcmp(pb->header->magic, RECORD_MAGIC, sizeof(pb->header->magic)) || pb->header->version != RECORD_VERSION
+       || pb->header->entry_size != sizeof(TRecordEntry))
+    {
+        PlaybackClose(pb);
+        return 1;
+    }
+    pb->entry = (TRecordEntry *)(pb->header + 1);
+    pb->count = (pb->index_size - sizeof(TRecordHeader)) / sizeof(TRecordEntry);
+
+    /* play up to the first frame that is cut off, as after a crash, or
+       that changes the geometry the instance is set up for */
+    for(i = 0; i < pb->count; i++)
+        if(pb->entry[i].offset + pb->entry[i].length > pb->data_size
+           || pb->entry[i].width != pb->entry[0].width || pb->entry[i].height != pb->entry[0].height
+           || pb->entry[i].row != pb->entry[0].row || pb->entry[i].col != pb->entry[0].col
+           || pb->entry[i].bits != pb->entry[0].bits)
+            break;
+    pb->count = i;
+    if(pb->count == 0)
+    {
+        PlaybackClose(pb);
+        return 1;
+    }
+    madvise(pb->data, pb->data_size, MADV_SEQUENTIAL);
+
+    return 0;
+}
+
+void PlaybackClose(TPlayback * pb)
+{
+    PlaybackStop(pb);
+    if(pb->data)
+        munmap(pb->data, pb->data_size);
+    if(pb->header)
+        munmap(pb->header, pb->index_size);
+    pb->data = NULL;
+    pb->header = NULL;
+    pb->entry = NULL;
+    pb->count = 0;
+}
+
+void PlaybackGetFormat(TPlayback * pb, INT * width, INT * height, INT * col, INT * row, INT * bits)
+{
+    *width = pb->entry[0].width;
+    *height = pb->entry[0].height;
+    *col = pb->entry[0].col;
+    *row = pb->entry[0].row;
+    *bits = pb->entry[0].bits;
+}
+
+INT PlaybackStart(TPlayback * pb)
+{
+    if(ATOMIC_LOAD(pb->running))
+        return 0;
+    ATOMIC_STORE(pb->running, TRUE);
+    if(pthread_create(&pb->thread, NULL, PlaybackThread, pb) != 0)
+    {
+        ATOMIC_STORE(pb->running, FALSE);
+        return 1;
+    }
+
+    return 0;
+}
+
+INT PlaybackStop(TPlayback * pb)
+{
+    if(!ATOMIC_LOAD(pb->running))
+        return 0;
+    ATOMIC_STORE(pb->running, FALSE);
+    syscall(SYS_futex, &pb->triggers, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    pthread_join(pb->thread, NULL);
+
+    return 0;
+}
+
+INT PlaybackSetTrigger(TPlayback * pb, INT mode)
+{
+    switch(mode)
+    {
+        case TRIG_SW_START:
+            ATOMIC_STORE(pb->triggered, TRUE);
+            break;
+        case TRIG_SW_DO:
+            if(!ATOMIC_LOAD(pb->triggered))
+                return 1;
+            __atomic_add_fetch(&pb->triggers, 1, __ATOMIC_SEQ_CST);
+            syscall(SYS_futex, &pb->triggers, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+            break;
+        case TRIG_HW_START:
+        case TRIG_STOP:
+            ATOMIC_STORE(pb->triggered, FALSE);
+            break;
+        default:
+            return 1;
+    }
+
+    return 0;
+}
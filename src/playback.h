@@ -0,0 +1,72 @@
+/** \file playback.h
+ * \brief Recording playback device for the NET iCube acquisition interface.
+ */
+
+#ifndef __PLAYBACK_H__
+#define __PLAYBACK_H__
+
+#include <pthread.h>
+
+#include <Halcon.h>
+
+#include "recorder.h"
+
+/* Playback timing modes.                                                 */
+enum {
+    PLAYBACK_RECORDED = 0,
+    PLAYBACK_FIXED,
+    PLAYBACK_MAX
+};
+
+/* Frame callback, as registered with the camera library.                 */
+typedef INT (*TPlaybackCallback)(void * buffer, UINT bsize, void * context);
+
+/* Check whether the callback has room for another frame.                 */
+typedef HBOOL (*TPlaybackReady)(void * context);
+
+typedef struct
+{
+    HBYTE * data;
+    size_t data_size;
+    TRecordHeader * header;
+    TRecordEntry * entry;
+    size_t index_size;
+    UINT count;
+    TPlaybackCallback callback;
+    TPlaybackReady ready;
+    void * context;
+    INT timing;
+    double rate;
+    HBOOL loop;
+    HBOOL triggered;
+    UINT triggers;
+    UINT next;
+    UINT played;
+    HBOOL running;
+    pthread_t thread;
+} TPlayback;
+
+/* Map a recording made by the recorder. Returns 0 on success.            */
+extern INT PlaybackOpen(TPlayback * pb, const char * filename);
+
+/* Unmap the recording, stopping playback first.                          */
+extern void PlaybackClose(TPlayback * pb);
+
+/* Geometry of the recording, taken from its first frame; playback stops
+ * short of the first frame of another geometry.                          */
+extern void PlaybackGetFormat(TPlayback * pb, INT * width, INT * height, INT * col, INT * row, INT * bits);
+
+/* Start delivering frames to the callback, continuing after the last
+ * frame played. At the max timing, each frame waits until ready (if set)
+ * reports room for it. Returns 0 on success.                             */
+extern INT PlaybackStart(TPlayback * pb);
+
+/* Stop delivering frames. Returns 0 on success.                          */
+extern INT PlaybackStop(TPlayback * pb);
+
+/* Apply a camera library trigger command: with a software trigger
+ * started, each TRIG_SW_DO plays one frame; otherwise, frames play at
+ * the timing set.                                                        */
+extern INT PlaybackSetTrigger(TPlayback * pb, INT mode);
+
+#endif /* __PLAYBACK_H__ */
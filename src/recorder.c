@@ -0,0 +1,321 @@
+/** \file recorder.c
+ * \brief Raw frame recorder for the NET iCube acquisition interface.
+ */
+
+#define _GNU_SOURCE
+
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "recorder.h"
+
+/* Data file space reserved ahead of the writer, in bytes.                */
+#define RECORD_PREALLOCATE (64 << 20)
+
+/* Longest sleep of an idle writer in milliseconds.                       */
+#define RECORD_IDLE_WAIT 100
+
+#define ATOMIC_LOAD(X) __atomic_load_n(&(X), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(X, V) __atomic_store_n(&(X), (V), __ATOMIC_SEQ_CST)
+
+static UINT Padded(UINT length)
+{
+    return (length + RECORD_ALIGN - 1) & ~(UINT)(RECORD_ALIGN - 1);
+}
+
+static void FreeSlots(TRecorder * rec)
+{
+    INT i;
+
+    for(i = 0; i < RECORD_SLOTS; i++)
+    {
+        free(rec->image[i]);
+        rec->image[i] = NULL;
+    }
+    rec->size = 0;
+}
+
+/* Write a whole buffer at offset, retrying short writes.                 */
+static INT WriteAt(int fd, const HBYTE * data, UINT length, uint64_t offset)
+{
+    ssize_t n;
+
+    while(length > 0)
+    {
+        n = pwrite(fd, data, length, (off_t)offset);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return 1;
+        data += n;
+        length -= (UINT)n;
+        offset += (uint64_t)n;
+    }
+
+    return 0;
+}
+
+/* Write one queued frame and its index entry.                            */
+static INT WriteFrame(TRecorder * rec, INT slot)
+{
+    TRecordEntry * entry = &rec->entry[slot];
+    UINT padded = Padded(entry->length);
+
+    /* keep the file allocated ahead of the data, so that writes do not
+       wait for the file system to find blocks */
+    if(rec->offset + padded > rec->allocated)
+    {
+        if(posix_fallocate(rec->data_fd, (off_t)rec->allocated, RECORD_PREALLOCATE + padded) == 0)
+            rec->allocated += RECORD_PREALLOCATE + padded;
+    }
+
+    /* the padding keeps O_DIRECT writes aligned */
+    memset(rec->image[slot] + entry->length, 0, padded - entry->length);
+    if(WriteAt(rec->data_fd, rec->image[slot], padded, rec->offset) != 0)
+        return 1;
+    entry->offset = rec->offset;
+    rec->offset += padded;
+
+    return WriteAt(rec->index_fd, (const HBYTE *)entry, sizeof(TRecordEntry),
+                   sizeof(TRecordHeader) + (uint64_t)rec->written * sizeof(TRecordEntry));
+}
+
+static void * WriterThread(void * arg)
+{
+    TRecorder * rec = (TRecorder *)arg;
+    struct timespec ts;
+    UINT head, tail = rec->tail;
+    INT slot;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = RECORD_IDLE_WAIT * 1000000L;
+
+    for(;;)
+    {
+        head = ATOMIC_LOAD(rec->head);
+        if(tail == head)
+        {
+            if(!ATOMIC_LOAD(rec->running))
+                break;
+            /* the callback only wakes the writer while it waits */
+            ATOMIC_STORE(rec->waiting, TRUE);
+            syscall(SYS_futex, &rec->head, FUTEX_WAIT_PRIVATE, head, &ts, NULL, 0);
+            ATOMIC_STORE(rec->waiting, FALSE);
+            continue;
+        }
+        slot = tail % RECORD_SLOTS;
+        /* a pinned frame is copied here, off the camera callback */
+        if(rec->source[slot])
+        {
+            if(!rec->failed)
+                memcpy(rec->image[slot], rec->source[slot], rec->entry[slot].length);
+            ATOMIC_STORE(*rec->pin[slot], FALSE);
+        }
+        if(!rec->failed && WriteFrame(rec, slot) != 0)
+            rec->failed = TRUE;
+        /* frames are no longer written once a write failed */
+        if(rec->failed)
+            __atomic_add_fetch(&rec->dropped, 1, __ATOMIC_RELAXED);
+        else
+            __atomic_add_fetch(&rec->written, 1, __ATOMIC_RELAXED);
+        ATOMIC_STORE(rec->tail, ++tail);
+    }
+
+    return NULL;
+}
+
+void RecorderInit(TRecorder * rec)
+{
+    memset(rec, 0, sizeof(TRecorder));
+    rec->data_fd = -1;
+    rec->index_fd = -1;
+}
+
+/* Make the queue slots hold frames of up to size bytes.                  */
+static INT AllocateSlots(TRecorder * rec, UINT size)
+{
+    void * ptr;
+    INT i;
+
+    size = Padded(size);
+    if(size <= rec->size)
+        return 0;
+    for(i = 0; i < RECORD_SLOTS; i++)
+    {
+        if(posix_memalign(&ptr, RECORD_ALIGN, size) != 0)
+        {
+            FreeSlots(rec);
+            return 1;
+        }
+        free(rec->image[i]);
+        rec->image[i] = (HBYTE *)ptr;
+    }
+    rec->size = size;
+
+    return 0;
+}
+
+INT RecorderFormat(TRecorder * rec, INT width, INT height, INT row, INT col, INT bits, UINT size)
+{
+    /* frames queued in the old format are written out first */
+    while(ATOMIC_LOAD(rec->running) && ATOMIC_LOAD(rec->tail) != rec->head)
+        sched_yield();
+
+    rec->format.width = width;
+    rec->format.height = height;
+    rec->format.row = row;
+    rec->format.col = col;
+    rec->format.bits = bits;
+    rec->frame_size = size;
+
+    /* the slots only exist while recording */
+    return ATOMIC_LOAD(rec->running) ? AllocateSlots(rec, size) : 0;
+}
+
+/* Open the recording files and write the index header.                  */
+static INT OpenFiles(TRecorder * rec, const char * filename)
+{
+    char index_name[RECORD_PATH_MAX + sizeof(RECORD_INDEX_SUFFIX)];
+    TRecordHeader header;
+
+    strcpy(index_name, filename);
+    strcat(index_name, RECORD_INDEX_SUFFIX);
+
+    /* bypass the page cache where the file system allows it */
+    rec->data_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if(rec->data_fd < 0 && errno == EINVAL)
+        rec->data_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    rec->index_fd = open(index_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(rec->data_fd < 0 || rec->index_fd < 0)
+        return 1;
+
+    memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    header.entry_size = sizeof(TRecordEntry);
+
+    return WriteAt(rec->index_fd, (const HBYTE *)&header, sizeof(header), 0);
+}
+
+static INT CloseFiles(TRecorder * rec)
+{
+    INT err = 0;
+
+    if(rec->data_fd >= 0)
+        err |= close(rec->data_fd) != 0;
+    if(rec->index_fd >= 0)
+        err |= close(rec->index_fd) != 0;
+    rec->data_fd = rec->index_fd = -1;
+
+    return err;
+}
+
+INT RecorderStart(TRecorder * rec, const char * filename)
+{
+    if(ATOMIC_LOAD(rec->running) || strlen(filename) >= RECORD_PATH_MAX)
+        return 1;
+    if(AllocateSlots(rec, rec->frame_size) != 0)
+        return 1;
+    if(OpenFiles(rec, filename) != 0)
+    {
+        CloseFiles(rec);
+        FreeSlots(rec);
+        return 1;
+    }
+
+    rec->head = rec->tail = 0;
+    rec->written = rec->dropped = 0;
+    rec->offset = rec->allocated = 0;
+    rec->failed = FALSE;
+    rec->waiting = FALSE;
+    ATOMIC_STORE(rec->running, TRUE);
+    if(pthread_create(&rec->thread, NULL, WriterThread, rec) != 0)
+    {
+        ATOMIC_STORE(rec->running, FALSE);
+        CloseFiles(rec);
+        FreeSlots(rec);
+        return 1;
+    }
+
+    return 0;
+}
+
+INT RecorderStop(TRecorder * rec)
+{
+    INT err;
+
+    if(!ATOMIC_LOAD(rec->running))
+        return 0;
+
+    /* once no push is under way, none will start until the next start */
+    ATOMIC_STORE(rec->running, FALSE);
+    while(ATOMIC_LOAD(rec->pushing))
+        sched_yield();
+    syscall(SYS_futex, &rec->head, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    pthread_join(rec->thread, NULL);
+
+    /* drop the space reserved beyond the last frame */
+    err = rec->failed || ftruncate(rec->data_fd, (off_t)rec->offset) != 0;
+    err |= CloseFiles(rec);
+    FreeSlots(rec);
+
+    return err;
+}
+
+/* Queue a frame, copying it unless the caller pins it in place.        */
+static void Push(TRecorder * rec, const void * frame, UINT length, UINT seq, double time, INT * pin)
+{
+    TRecordEntry * entry;
+    UINT head = rec->head;
+    INT slot = head % RECORD_SLOTS;
+
+    ATOMIC_STORE(rec->pushing, TRUE);
+    if(!ATOMIC_LOAD(rec->running))
+    {
+        ATOMIC_STORE(rec->pushing, FALSE);
+        return;
+    }
+
+    if(head - ATOMIC_LOAD(rec->tail) >= RECORD_SLOTS || length > rec->size)
+        __atomic_add_fetch(&rec->dropped, 1, __ATOMIC_RELAXED);
+    else
+    {
+        entry = &rec->entry[slot];
+        *entry = rec->format;
+        entry->seq = seq;
+        entry->length = length;
+        entry->time = time;
+        if(pin)
+        {
+            rec->source[slot] = (const HBYTE *)frame;
+            rec->pin[slot] = pin;
+            ATOMIC_STORE(*pin, TRUE);
+        }
+        else
+        {
+            rec->source[slot] = NULL;
+            memcpy(rec->image[slot], frame, length);
+        }
+        ATOMIC_STORE(rec->head, head + 1);
+        if(ATOMIC_LOAD(rec->waiting))
+            syscall(SYS_futex, &rec->head, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    ATOMIC_STORE(rec->pushing, FALSE);
+}
+
+void RecorderPush(TRecorder * rec, const void * frame, UINT length, UINT seq, double time)
+{
+    Push(rec, frame, length, seq, time, NULL);
+}
+
+void RecorderPushPinned(TRecorder * rec, const void * frame, UINT length, UINT seq, double time, INT * pin)
+{
+    Push(rec, frame, length, seq, time, pin);
+}
@@ -0,0 +1,97 @@
+/** \file recorder.h
+ * \brief Raw frame recorder for the NET iCube acquisition interface.
+ */
+
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <Halcon.h>
+
+/* A recording is a data file holding the raw frames back to back, each
+ * padded to RECORD_ALIGN bytes, and an index file (the data file name
+ * followed by RECORD_INDEX_SUFFIX) holding a TRecordHeader followed by
+ * one TRecordEntry per frame.                                            */
+#define RECORD_MAGIC "ICUBEREC"
+#define RECORD_VERSION 1
+#define RECORD_ALIGN 4096
+#define RECORD_INDEX_SUFFIX ".idx"
+#define RECORD_PATH_MAX 1024
+
+/* Frames queued between the camera callback and the writer thread.      */
+#define RECORD_SLOTS 32
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+} TRecordHeader;
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t seq;
+    uint32_t length;
+    double time;
+    int32_t width;
+    int32_t height;
+    int32_t row;
+    int32_t col;
+    int32_t bits;
+    uint32_t reserved;
+} TRecordEntry;
+
+typedef struct
+{
+    HBYTE * image[RECORD_SLOTS];
+    TRecordEntry entry[RECORD_SLOTS];
+    const HBYTE * source[RECORD_SLOTS];
+    INT * pin[RECORD_SLOTS];
+    UINT size;
+    UINT frame_size;
+    TRecordEntry format;
+    UINT head;
+    UINT tail;
+    HBOOL running;
+    HBOOL pushing;
+    HBOOL waiting;
+    HBOOL failed;
+    UINT written;
+    UINT dropped;
+    int data_fd;
+    int index_fd;
+    uint64_t offset;
+    uint64_t allocated;
+    pthread_t thread;
+} TRecorder;
+
+/* Prepare an idle recorder.                                              */
+extern void RecorderInit(TRecorder * rec);
+
+/* Set the geometry recorded with the following frames, of up to size
+ * bytes each. Must not run concurrently with RecorderPush. Returns 0 on
+ * success.                                                               */
+extern INT RecorderFormat(TRecorder * rec, INT width, INT height, INT row, INT col, INT bits, UINT size);
+
+/* Create the recording files and start the writer thread. Returns 0 on
+ * success.                                                               */
+extern INT RecorderStart(TRecorder * rec, const char * filename);
+
+/* Write out the queued frames, stop the writer thread and close the
+ * files. Returns 0 if every frame was written.                           */
+extern INT RecorderStop(TRecorder * rec);
+
+/* Queue a frame for writing, or count it as dropped if the writer is
+ * behind. Called from the camera callback only; never blocks.            */
+extern void RecorderPush(TRecorder * rec, const void * frame, UINT length, UINT seq, double time);
+
+/* Queue a frame the caller keeps in place: *pin is set while it is
+ * queued and cleared once the writer thread has copied the frame, and
+ * the caller must not reuse the memory in between. Called from the
+ * camera callback only; never blocks.                                    */
+extern void RecorderPushPinned(TRecorder * rec, const void * frame, UINT length, UINT seq, double time, INT * pin);
+
+#endif /* __RECORDER_H__ */